@@ -0,0 +1,56 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "backlog.h"
+
+struct backlog *backlog_create(int capacity, size_t stride)
+{
+  struct backlog *b;
+
+  /* the state and its arrays are one block, widest elements first */
+  b = malloc(sizeof(struct backlog) + capacity * (stride + sizeof(float)));
+  if (b == 0) {
+    printf("memory allocation for backlog failed.");
+    exit(EXIT_FAILURE);
+  }
+  b->capacity = capacity;
+  b->head = 0;
+  b->count = 0;
+  b->stride = stride;
+  b->msgs = (struct msg *)(b + 1);
+  b->since = (float *)((char *)b->msgs + capacity * stride);
+  return b;
+}
+
+void backlog_destroy(struct backlog *b)
+{
+  free(b);
+}
+
+int backlog_push(struct backlog *b, const struct msg *m, float now)
+{
+  struct msg *slot;
+  int i;
+
+  if (b->count == b->capacity)
+    return -1;
+  i = b->head + b->count;
+  if (i >= b->capacity)
+    i -= b->capacity;
+  slot = msg_at(b->msgs, b->stride, i);
+  slot->length = m->length;
+  memcpy(slot->data, m->data, m->length);   /* only the bytes in use */
+  b->since[i] = now;
+  b->count++;
+  return 0;
+}
+
+void backlog_pop(struct backlog *b, int n, float now, double *delay)
+{
+  while (n-- > 0) {
+    *delay += now - b->since[b->head];
+    if (++b->head == b->capacity)
+      b->head = 0;
+    b->count--;
+  }
+}
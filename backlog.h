@@ -0,0 +1,46 @@
+#ifndef BACKLOG_H
+#define BACKLOG_H
+
+#include "emulator.h"
+
+/* ******************************************************************
+   Sender backlog, the "backlog" parameter.
+
+   Messages from layer 5 that find the send window full wait here, in
+   arrival order, instead of being dropped.  The backlog is a ring of
+   capacity messages; only a message that finds the ring full as well
+   is dropped.  Each message remembers when it arrived, for the
+   queueing delay statistics.
+**********************************************************************/
+
+struct backlog {
+  int capacity;             /* messages the ring holds */
+  int head;                 /* index of the oldest message */
+  int count;                /* messages waiting */
+  size_t stride;            /* bytes between its messages, see msg_at() */
+  struct msg *msgs;         /* [capacity] the ring */
+  float *since;             /* [capacity] arrival time of each message */
+};
+
+/* an empty backlog of capacity messages stride bytes apart (see */
+/* msg_stride() in protocol.h), capacity > 0 */
+extern struct backlog *backlog_create(int capacity, size_t stride);
+extern void backlog_destroy(struct backlog *b);
+
+/* append m, which arrived at time now.  returns -1 if the ring is full */
+extern int backlog_push(struct backlog *b, const struct msg *m, float now);
+
+/* the oldest messages, as many as are stored contiguously: the ring */
+/* may wrap, so later ones may follow after backlog_pop().  returns */
+/* their number, 0 if the backlog is empty */
+#define backlog_run(b) \
+  ((b)->head + (b)->count <= (b)->capacity ? (b)->count : (b)->capacity - (b)->head)
+
+/* the first message of the run */
+#define backlog_first(b) msg_at((b)->msgs, (b)->stride, (b)->head)
+
+/* remove the n oldest messages, adding the time they waited until */
+/* now to *delay */
+extern void backlog_pop(struct backlog *b, int n, float now, double *delay);
+
+#endif
@@ -0,0 +1,560 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "emulator.h"
+#include "bench.h"
+#include "checksum.h"
+#include "protocol.h"
+
+#define BATCH      4096     /* operations between fresh simulations */
+#define MAX_BENCH  64
+#define MAX_E2E    10000000
+
+/* with -DBENCH_ALLOCS every heap allocation of the process is counted */
+/* by wrapping glibc's allocator.  the wrappers replace malloc for the */
+/* whole binary, every run and tool in it included, so only build them */
+/* into a binary kept for benchmarking */
+#if defined(BENCH_ALLOCS) && defined(__GLIBC__)
+#include <errno.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *p);
+
+static unsigned long nallocs;
+
+#define ALLOCS_COUNTED  1
+
+void *malloc(size_t size)
+{
+  __atomic_add_fetch(&nallocs, 1, __ATOMIC_RELAXED);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+  __atomic_add_fetch(&nallocs, 1, __ATOMIC_RELAXED);
+  return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size)
+{
+  __atomic_add_fetch(&nallocs, 1, __ATOMIC_RELAXED);
+  return __libc_realloc(p, size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+  __atomic_add_fetch(&nallocs, 1, __ATOMIC_RELAXED);
+  return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+  __atomic_add_fetch(&nallocs, 1, __ATOMIC_RELAXED);
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **p, size_t alignment, size_t size)
+{
+  void *q;
+
+  if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0)
+    return EINVAL;
+  __atomic_add_fetch(&nallocs, 1, __ATOMIC_RELAXED);
+  if ((q = __libc_memalign(alignment, size)) == NULL)
+    return ENOMEM;
+  *p = q;
+  return 0;
+}
+
+void free(void *p)
+{
+  __libc_free(p);
+}
+
+#define ALLOCS()  ((long)__atomic_load_n(&nallocs, __ATOMIC_RELAXED))
+#else
+#define ALLOCS_COUNTED  0
+#define ALLOCS()  0L
+#endif
+
+/* allocations per operation of r, -1 if they were not counted */
+#define ALLOCSPEROP(r)  ((r)->allocs < 0 ? -1.0 : (double)(r)->allocs / (r)->ops)
+
+/* what one run of a benchmark measured */
+struct result {
+  long ops;                 /* operations timed (messages end to end) */
+  double seconds;
+  long events;              /* events scheduled meanwhile */
+  long allocs;
+};
+
+struct bench {
+  char name[64];
+  long ops;                 /* operations asked for */
+  const struct protocol *protocol;
+  int arg;                  /* heap depth, checksum kind, ... */
+  int payload;
+  void (*run)(const struct bench *b, struct result *r);
+};
+
+static double volatile sink;   /* keeps computed values alive */
+
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* a quiet simulation that generates no messages, its first (empty) */
+/* layer 5 arrival already out of the way */
+static struct simulation *quietsim(const struct protocol *protocol, int payload)
+{
+  struct sim_params p;
+  struct simulation *sim;
+
+  params_default(&p);
+  p.protocol = protocol;
+  p.windowsize = 16;
+  p.seqspace = 32;      /* a power of two, so every build takes it */
+  p.nsimmax = 0;
+  p.lossprob = 0.0;
+  p.corruptprob = 0.0;
+  p.trace = 0;
+  p.payload = payload;
+  if ((sim = sim_create(&p)) == NULL)
+    exit(EXIT_FAILURE);
+  sim_step(sim);
+  return sim;
+}
+
+/* start and stop of the timed part of a benchmark run */
+static void begin(struct result *r, const struct simulation *sim)
+{
+  r->seconds -= now();
+  r->allocs -= ALLOCS();
+  if (sim != NULL)
+    r->events -= (long)sim->evseqnext;
+}
+
+static void end(struct result *r, const struct simulation *sim)
+{
+  if (sim != NULL)
+    r->events += (long)sim->evseqnext;
+  r->allocs += ALLOCS();
+  r->seconds += now();
+}
+
+/********************* MICRO BENCHMARKS *******/
+
+/* one insert and one pop with b->arg events in the heap */
+static void runevents(const struct bench *b, struct result *r)
+{
+  struct simulation *sim = quietsim(protocol_at(0), 20);
+  struct rng g;
+  float *t;
+  long i;
+
+  t = malloc(BATCH * sizeof(float));
+  if (t == 0) {
+    printf("memory allocation for event times failed.");
+    exit(EXIT_FAILURE);
+  }
+  rng_seed(&g, RNG_XOSHIRO256SS, 1, 0);
+  for (i = 0; i < BATCH; i++)
+    t[i] = 1000 + 1000 * rng_uniform(&g);
+  for (i = 0; i < b->arg; i++)
+    sim_idle(sim, t[i % BATCH]);
+  begin(r, sim);
+  for (i = 0; i < b->ops; i++) {
+    sim_idle(sim, t[i % BATCH]);
+    sim_step(sim);
+  }
+  end(r, sim);
+  r->ops = b->ops;
+  free(t);
+  sim_destroy(sim);
+}
+
+/* starttimer() and stoptimer(), with the heap cleared of the */
+/* cancelled timers every BATCH pairs as the main loop would  */
+static void runtimers(const struct bench *b, struct result *r)
+{
+  struct simulation *sim = quietsim(protocol_at(0), 20);
+  long i;
+
+  begin(r, sim);
+  for (i = 0; i < b->ops; i++) {
+    starttimer(sim, A, 16.0);
+    stoptimer(sim, A);
+    if (i % BATCH == BATCH - 1)
+      while (sim_step(sim))
+        ;
+  }
+  end(r, sim);
+  r->ops = b->ops;
+  sim_destroy(sim);
+}
+
+/* tolayer3() of data packets over a channel losing and corrupting 10% */
+static void runtolayer3(const struct bench *b, struct result *r)
+{
+  struct simulation *sim = NULL;
+  struct pkt p;
+  long i;
+
+  memset(&p, 0, sizeof(p));
+  p.length = b->payload;
+  p.flags = PKT_DATA;
+  memset(p.payload, 'a', p.length);
+  for (i = 0; i < b->ops; i++) {
+    if (i % BATCH == 0) {    /* a fresh channel, untimed */
+      if (sim != NULL) {
+        end(r, sim);
+        sim_destroy(sim);
+      }
+      sim = quietsim(protocol_at(0), b->payload);
+      sim->params.lossprob = 0.1;
+      sim->params.corruptprob = 0.1;
+      begin(r, sim);
+    }
+    p.seqnum = (int)i;
+    tolayer3(sim, A, &p);
+  }
+  if (sim != NULL) {
+    end(r, sim);
+    sim_destroy(sim);
+  }
+  r->ops = b->ops;
+}
+
+/* the checksum of kind b->arg over a packet of b->payload bytes */
+static void runchecksum(const struct bench *b, struct result *r)
+{
+  struct pkt p;
+  uint32_t acc = 0;
+  long i;
+
+  checksum_init();
+  memset(&p, 0, sizeof(p));
+  p.length = b->payload;
+  p.flags = PKT_DATA;
+  memset(p.payload, 'a', p.length);
+  begin(r, NULL);
+  for (i = 0; i < b->ops; i++) {
+    p.seqnum = (int)i;
+    acc += checksum_compute(b->arg, &p);
+  }
+  end(r, NULL);
+  sink = acc;
+  r->ops = b->ops;
+}
+
+/* output() at A of one message and input() at A of its ACK */
+static void runsender(const struct bench *b, struct result *r)
+{
+  struct simulation *sim = NULL;
+  struct msg m;
+  struct pkt ack;
+  long i;
+
+  m.length = b->payload;
+  memset(m.data, 'a', m.length);
+  memset(&ack, 0, sizeof(ack));
+  ack.seqnum = -1;
+  ack.flags = PKT_ACK;
+  ack.length = ACKLEN;
+  memset(ack.payload, '0', ACKLEN);
+  for (i = 0; i < b->ops; i++) {
+    if (i % BATCH == 0) {
+      if (sim != NULL) {
+        end(r, sim);
+        sim_destroy(sim);
+      }
+      sim = quietsim(b->protocol, b->payload);
+      begin(r, sim);
+    }
+    b->protocol->output(sim, A, &m, 1);
+    ack.acknum = (int)((i % BATCH) % sim->params.seqspace);
+    ack.checksum = ComputeChecksum(sim, &ack);
+    b->protocol->input(sim, A, &ack);
+  }
+  if (sim != NULL) {
+    end(r, sim);
+    sim_destroy(sim);
+  }
+  r->ops = b->ops;
+}
+
+/* input() at B of in-order data packets, each delivered and ACKed */
+static void runreceiver(const struct bench *b, struct result *r)
+{
+  struct simulation *sim = NULL;
+  struct pkt p;
+  long i;
+
+  memset(&p, 0, sizeof(p));
+  p.acknum = -1;
+  p.flags = PKT_DATA;
+  p.length = b->payload;
+  memset(p.payload, 'a', p.length);
+  for (i = 0; i < b->ops; i++) {
+    if (i % BATCH == 0) {
+      if (sim != NULL) {
+        end(r, sim);
+        sim_destroy(sim);
+      }
+      sim = quietsim(b->protocol, b->payload);
+      begin(r, sim);
+    }
+    p.seqnum = (int)((i % BATCH) % sim->params.seqspace);
+    p.checksum = ComputeChecksum(sim, &p);
+    b->protocol->input(sim, B, &p);
+  }
+  if (sim != NULL) {
+    end(r, sim);
+    sim_destroy(sim);
+  }
+  r->ops = b->ops;
+}
+
+/********************* END TO END *******/
+
+/* b->ops messages at a fixed seed over a channel losing and corrupting */
+/* 10% of the packets, creating and freeing the simulation included */
+static void runsim(const struct bench *b, struct result *r)
+{
+  struct sim_params p;
+  struct simulation *sim;
+
+  params_default(&p);
+  p.protocol = b->protocol;
+  p.windowsize = 16;
+  p.seqspace = 32;      /* as in quietsim() */
+  p.nsimmax = (int)b->ops;
+  p.lossprob = 0.1;
+  p.corruptprob = 0.1;
+  p.lambda = 10;
+  p.adaptiverto = 1;
+  p.trace = 0;
+  p.seed = 1;
+  begin(r, NULL);
+  if ((sim = sim_create(&p)) == NULL)
+    exit(EXIT_FAILURE);
+  sim_run(sim);
+  r->events = (long)sim->evseqnext;
+  sim_destroy(sim);
+  end(r, NULL);
+  r->ops = b->ops;
+}
+
+/********************* DRIVER *******/
+
+static void add(struct bench *list, int *n, const char *name, long ops,
+                const struct protocol *protocol, int arg, int payload,
+                void (*run)(const struct bench *, struct result *))
+{
+  struct bench *b = &list[(*n)++];
+
+  snprintf(b->name, sizeof(b->name), "%s", name);
+  b->ops = ops > 0 ? ops : 1;
+  b->protocol = protocol;
+  b->arg = arg;
+  b->payload = payload;
+  b->run = run;
+}
+
+/* every benchmark, micro ones scaled by scale */
+static int benchlist(struct bench *list, double scale, long maxmessages)
+{
+  static const int payloads[] = { 20, 1500 };
+  const struct protocol *pr;
+  char name[64];
+  long m;
+  int i, j, n = 0;
+
+  add(list, &n, "events.depth64", (long)(4e6 * scale), NULL, 64, 20, runevents);
+  add(list, &n, "events.depth65536", (long)(2e6 * scale), NULL, 65536, 20, runevents);
+  add(list, &n, "timers.start_stop", (long)(4e6 * scale), NULL, 0, 20, runtimers);
+  add(list, &n, "tolayer3.20", (long)(2e6 * scale), NULL, 0, 20, runtolayer3);
+  add(list, &n, "tolayer3.1500", (long)(5e5 * scale), NULL, 0, 1500, runtolayer3);
+  for (i = CKSUM_SUM; i <= CKSUM_CRC32C; i++)
+    for (j = 0; j < 2; j++) {
+      snprintf(name, sizeof(name), "checksum.%s.%d", checksum_name(i), payloads[j]);
+      add(list, &n, name, (long)((payloads[j] > 100 ? 5e5 : 4e6) * scale), NULL, i,
+          payloads[j], runchecksum);
+    }
+  for (i = 0; (pr = protocol_at(i)) != NULL; i++) {
+    snprintf(name, sizeof(name), "%s.A_output_input", pr->name);
+    add(list, &n, name, (long)(2e6 * scale), pr, 0, 20, runsender);
+    snprintf(name, sizeof(name), "%s.B_input", pr->name);
+    add(list, &n, name, (long)(2e6 * scale), pr, 0, 20, runreceiver);
+  }
+  for (i = 0; (pr = protocol_at(i)) != NULL; i++)
+    for (m = 1000; m <= maxmessages && n < MAX_BENCH; m *= 10) {
+      snprintf(name, sizeof(name), "sim.%s.%ld", pr->name, m);
+      add(list, &n, name, m, pr, 0, 20, runsim);
+    }
+  return n;
+}
+
+static void writecsv(FILE *fp, const struct bench *list, const struct result *res, int n)
+{
+  const struct result *r;
+  int i;
+
+  fprintf(fp, "name,ops,seconds,ops_per_sec,ns_per_op,events,events_per_sec,allocs,allocs_per_op\n");
+  for (i = 0; i < n; i++) {
+    r = &res[i];
+    fprintf(fp, "%s,%ld,%.6f,%.6g,%.6g,%ld,%.6g,%ld,%.6g\n", list[i].name, r->ops, r->seconds,
+            r->ops / r->seconds, 1e9 * r->seconds / r->ops, r->events, r->events / r->seconds,
+            r->allocs, ALLOCSPEROP(r));
+  }
+}
+
+static void writejson(FILE *fp, const struct bench *list, const struct result *res, int n)
+{
+  const struct result *r;
+  int i;
+
+  fprintf(fp, "[\n");
+  for (i = 0; i < n; i++) {
+    r = &res[i];
+    fprintf(fp, "  {\"name\": \"%s\", \"ops\": %ld, \"seconds\": %.6f, \"ops_per_sec\": %.6g, "
+            "\"ns_per_op\": %.6g, \"events\": %ld, \"events_per_sec\": %.6g, "
+            "\"allocs\": %ld, \"allocs_per_op\": %.6g}%s\n", list[i].name, r->ops, r->seconds,
+            r->ops / r->seconds, 1e9 * r->seconds / r->ops, r->events, r->events / r->seconds,
+            r->allocs, ALLOCSPEROP(r), (i + 1 < n) ? "," : "");
+  }
+  fprintf(fp, "]\n");
+}
+
+/* check the results against the CSV of an earlier run.  returns the */
+/* number of regressions (after printing them), -1 if file is unreadable */
+static int compare(const char *file, double tolerance,
+                   const struct bench *list, const struct result *res, int n)
+{
+  FILE *fp;
+  char line[512], name[64];
+  double opsps, allocsperop, nowopsps, nowallocs;
+  int i, bad = 0;
+
+  if ((fp = fopen(file, "r")) == NULL) {
+    fprintf(stderr, "bench: cannot read %s\n", file);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (sscanf(line, "%63[^,],%*d,%*f,%lf,%*f,%*d,%*f,%*d,%lf", name, &opsps, &allocsperop) != 3)
+      continue;              /* the header, or not our CSV */
+    for (i = 0; i < n && strcmp(list[i].name, name) != 0; i++)
+      ;
+    if (i == n)
+      continue;
+    nowopsps = res[i].ops / res[i].seconds;
+    nowallocs = ALLOCSPEROP(&res[i]);
+    if (nowopsps < opsps * (1.0 - tolerance)) {
+      fprintf(stderr, "bench: %s is slower: %.6g ops/s, was %.6g\n", name, nowopsps, opsps);
+      bad++;
+    }
+    if (nowallocs >= 0 && allocsperop >= 0 && nowallocs > allocsperop + 1e-3) {
+      fprintf(stderr, "bench: %s allocates more: %.6g per op, was %.6g\n",
+              name, nowallocs, allocsperop);
+      bad++;
+    }
+  }
+  fclose(fp);
+  return bad;
+}
+
+static void benchusage(void)
+{
+  printf("usage: bench [--filter TEXT] [--repeat N] [--scale F] [--max-messages N]\n");
+  printf("             [--format csv|json] [--output FILE]\n");
+  printf("             [--compare FILE] [--tolerance F]\n");
+}
+
+int bench_main(int argc, char **argv)
+{
+  struct bench list[MAX_BENCH];
+  struct result res[MAX_BENCH], r;
+  const char *filter = "", *output = NULL, *format = "csv", *baseline = NULL;
+  double scale = 1.0, tolerance = 0.1;
+  long maxmessages = 1000000;
+  FILE *fp;
+  int i, k, n, nrun = 0, repeat = 3, bad = 0;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+      benchusage();
+      return EXIT_SUCCESS;
+    }
+    if (i + 1 < argc && strcmp(argv[i], "--filter") == 0)
+      filter = argv[++i];
+    else if (i + 1 < argc && strcmp(argv[i], "--repeat") == 0)
+      repeat = atoi(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "--scale") == 0)
+      scale = atof(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "--max-messages") == 0)
+      maxmessages = atol(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "--format") == 0)
+      format = argv[++i];
+    else if (i + 1 < argc && strcmp(argv[i], "--output") == 0)
+      output = argv[++i];
+    else if (i + 1 < argc && strcmp(argv[i], "--compare") == 0)
+      baseline = argv[++i];
+    else if (i + 1 < argc && strcmp(argv[i], "--tolerance") == 0)
+      tolerance = atof(argv[++i]);
+    else {
+      fprintf(stderr, "bench: unknown option %s\n", argv[i]);
+      benchusage();
+      return EXIT_FAILURE;
+    }
+  }
+  if (repeat < 1 || scale <= 0.0 || maxmessages > MAX_E2E || tolerance < 0.0) {
+    fprintf(stderr, "bench: need --repeat >= 1, --scale > 0, --max-messages <= %d "
+            "and --tolerance >= 0\n", MAX_E2E);
+    return EXIT_FAILURE;
+  }
+  if (strcmp(format, "csv") != 0 && strcmp(format, "json") != 0) {
+    fprintf(stderr, "bench: unknown format %s\n", format);
+    return EXIT_FAILURE;
+  }
+
+  n = benchlist(list, scale, maxmessages);
+  for (i = 0; i < n; i++) {
+    if (strstr(list[i].name, filter) == NULL)
+      continue;
+    for (k = 0; k < repeat; k++) {   /* keep the fastest run */
+      memset(&r, 0, sizeof(r));
+      list[i].run(&list[i], &r);
+      if (k == 0 || r.seconds < res[nrun].seconds)
+        res[nrun] = r;
+    }
+    if (!ALLOCS_COUNTED)
+      res[nrun].allocs = -1;
+    list[nrun++] = list[i];
+    fprintf(stderr, "bench: %s done\n", list[nrun - 1].name);
+  }
+
+  fp = stdout;
+  if (output != NULL && (fp = fopen(output, "w")) == NULL) {
+    fprintf(stderr, "bench: cannot write %s\n", output);
+    return EXIT_FAILURE;
+  }
+  if (strcmp(format, "json") == 0)
+    writejson(fp, list, res, nrun);
+  else
+    writecsv(fp, list, res, nrun);
+  if (fp != stdout)
+    fclose(fp);
+
+  if (baseline != NULL && (bad = compare(baseline, tolerance, list, res, nrun)) != 0)
+    return EXIT_FAILURE;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,36 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/* ******************************************************************
+   Benchmarks of the emulator's hot paths.
+
+   Each micro benchmark times one path on its own, with its setup left
+   out of the timing: the event list (insert and pop), timer start and
+   stop, tolayer3(), the checksums, and the input routines of every
+   registered protocol.  The end-to-end benchmarks then run whole
+   simulations at a fixed seed, from 1000 messages up to --max-messages
+   (at most 10^7).  Every benchmark takes the best of --repeat runs.
+
+   usage: prog bench [--filter TEXT] [--repeat N] [--scale F]
+                     [--max-messages N] [--format csv|json]
+                     [--output FILE] [--compare FILE] [--tolerance F]
+
+   One row per benchmark: operations (messages for the end-to-end ones)
+   per second, ns per operation, events scheduled per second, and heap
+   allocations (malloc, calloc, realloc and the aligned ones) per
+   operation.  Allocations are only counted in a build with
+   -DBENCH_ALLOCS on glibc, which replaces the allocator of the whole
+   binary to count them, so it is meant for a binary of its own;
+   elsewhere they show as -1, and --compare leaves them out.
+
+   --compare reads the CSV of an earlier run and fails if a benchmark
+   of the same name got slower by more than --tolerance (default 0.1,
+   i.e. 10%) or now allocates more per operation, where both runs
+   counted allocations.
+**********************************************************************/
+
+/* run the benchmarks from command-line arguments (argv[0] is "bench"). */
+/* returns the process exit status */
+extern int bench_main(int argc, char **argv);
+
+#endif
@@ -0,0 +1,79 @@
+#include <string.h>
+#include "bitset.h"
+
+/* number of trailing zero bits of w, which is not 0 */
+#if defined(__GNUC__)
+#define ctz64(w) __builtin_ctzll(w)
+#else
+static int ctz64(uint64_t w)
+{
+  int n = 0;
+
+  while (!(w & 1)) {
+    w >>= 1;
+    n++;
+  }
+  return n;
+}
+#endif
+
+void bitset_zero(uint64_t *b, int n)
+{
+  memset(b, 0, BITSET_WORDS(n) * sizeof(uint64_t));
+}
+
+bool bitset_any(const uint64_t *b, int n)
+{
+  int i;
+
+  for (i = 0; i < BITSET_WORDS(n); i++)
+    if (b[i] != 0)
+      return true;
+  return false;
+}
+
+int bitset_ones(const uint64_t *b, int from, int n, int max)
+{
+  uint64_t word;
+  int count = 0, avail, run;
+
+  while (count < max) {
+    /* the bits from from to the end of its word, or of the set */
+    avail = 64 - (from & 63);
+    if (from + avail > n)
+      avail = n - from;
+    word = ~(b[from >> 6] >> (from & 63));
+    run = word == 0 ? 64 : ctz64(word);
+    if (run >= avail) {
+      count += avail;
+      from += avail;
+      if (from == n)
+        from = 0;
+    }
+    else {
+      count += run;
+      break;
+    }
+  }
+  return count < max ? count : max;
+}
+
+void bitset_clearrange(uint64_t *b, int from, int count, int n)
+{
+  uint64_t mask;
+  int k;
+
+  while (count > 0) {
+    k = 64 - (from & 63);
+    if (k > count)
+      k = count;
+    if (from + k > n)
+      k = n - from;
+    mask = k == 64 ? ~(uint64_t)0 : (((uint64_t)1 << k) - 1) << (from & 63);
+    b[from >> 6] &= ~mask;
+    count -= k;
+    from += k;
+    if (from == n)
+      from = 0;
+  }
+}
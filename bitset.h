@@ -0,0 +1,36 @@
+#ifndef BITSET_H
+#define BITSET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ******************************************************************
+   Bitsets.
+
+   A bitset of n bits is an array of BITSET_WORDS(n) 64-bit words,
+   bit i being bit i % 64 of word i / 64.  The run functions treat the
+   bits as a ring of n, as the sequence numbers of a window are, and
+   step over a whole word of set bits at a time.
+**********************************************************************/
+
+#define BITSET_WORDS(n)     (((n) + 63) / 64)
+
+#define bitset_test(b, i)   ((bool)(((b)[(i) >> 6] >> ((i) & 63)) & 1))
+#define bitset_set(b, i)    ((b)[(i) >> 6] |= (uint64_t)1 << ((i) & 63))
+#define bitset_clear(b, i)  ((b)[(i) >> 6] &= ~((uint64_t)1 << ((i) & 63)))
+
+/* clear all n bits */
+extern void bitset_zero(uint64_t *b, int n);
+
+/* true if any of the n bits is set */
+extern bool bitset_any(const uint64_t *b, int n);
+
+/* the number of consecutive set bits from bit from on, wrapping past */
+/* bit n-1 to bit 0, but at most max.  this is also the distance to */
+/* the first clear bit */
+extern int bitset_ones(const uint64_t *b, int from, int n, int max);
+
+/* clear count bits from bit from on, wrapping past bit n-1 to bit 0 */
+extern void bitset_clearrange(uint64_t *b, int from, int count, int n);
+
+#endif
@@ -0,0 +1,69 @@
+#include <string.h>
+#include "cc.h"
+
+static const char *const names[] = { "none", "aimd" };
+
+/* half of the packets in flight, and at least 2 so slow start follows */
+static double halve(int inflight)
+{
+  return inflight / 2 < 2 ? 2.0 : inflight / 2;
+}
+
+void cc_init(struct cc *c, int kind, int maxwindow)
+{
+  c->kind = kind;
+  c->maxwindow = maxwindow;
+  c->cwnd = 1.0;
+  c->ssthresh = maxwindow;
+  c->dupacks = 0;
+}
+
+void cc_ack(struct cc *c, int npackets)
+{
+  c->dupacks = 0;
+  if (c->kind == CC_NONE)
+    return;
+  while (npackets-- > 0) {
+    if (c->cwnd < c->ssthresh)
+      c->cwnd += 1.0;             /* slow start */
+    else
+      c->cwnd += 1.0 / c->cwnd;   /* congestion avoidance */
+  }
+  if (c->cwnd > c->maxwindow)
+    c->cwnd = c->maxwindow;
+}
+
+int cc_dupack(struct cc *c, int inflight)
+{
+  if (c->kind == CC_NONE || ++c->dupacks != CC_DUPTHRESH)
+    return 0;
+  c->ssthresh = halve(inflight);
+  c->cwnd = c->ssthresh < c->maxwindow ? c->ssthresh : c->maxwindow;
+  return 1;
+}
+
+void cc_timeout(struct cc *c, int inflight)
+{
+  c->dupacks = 0;
+  if (c->kind == CC_NONE)
+    return;
+  c->ssthresh = halve(inflight);
+  c->cwnd = 1.0;
+}
+
+int cc_byname(const char *name)
+{
+  int i;
+
+  for (i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++)
+    if (strcmp(names[i], name) == 0)
+      return i;
+  return -1;
+}
+
+const char *cc_name(int kind)
+{
+  if (kind < 0 || kind >= (int)(sizeof(names) / sizeof(names[0])))
+    return "?";
+  return names[kind];
+}
@@ -0,0 +1,58 @@
+#ifndef CC_H
+#define CC_H
+
+/* ******************************************************************
+   Congestion control of a sliding window sender, the "congestion"
+   parameter.
+
+   CC_NONE  the window is always the configured one, as before.
+   CC_AIMD  a congestion window cwnd, counted in packets, limits the
+            packets in flight to min(cwnd, window).  It starts at one
+            packet and grows by one for every packet ACKed while below
+            ssthresh (slow start), then by 1/cwnd per packet ACKed
+            (additive increase, about one packet per round trip).  A
+            timeout halves ssthresh from the packets in flight and
+            drops cwnd back to one; a third duplicate ACK does the same
+            but only halves cwnd (multiplicative decrease), and the
+            sender retransmits the missing packet at once (fast
+            retransmit).
+
+   There is no fast recovery: cwnd is not inflated by further
+   duplicate ACKs, so the window only reopens as new data is ACKed.
+**********************************************************************/
+
+#define CC_NONE  0
+#define CC_AIMD  1
+
+#define CC_DUPTHRESH  3     /* duplicate ACKs that signal a lost packet */
+
+struct cc {
+  int kind;                 /* CC_ kind */
+  int maxwindow;            /* the configured window, cwnd never exceeds it */
+  double cwnd;              /* congestion window, in packets */
+  double ssthresh;          /* slow start threshold */
+  int dupacks;              /* duplicate ACKs since the window last moved */
+};
+
+/* start of a connection with at most maxwindow packets in flight */
+extern void cc_init(struct cc *c, int kind, int maxwindow);
+
+/* npackets new packets were ACKed and the window moved */
+extern void cc_ack(struct cc *c, int npackets);
+
+/* an ACK that did not move the window.  returns true on the */
+/* CC_DUPTHRESH'th in a row: fast retransmit the first packet */
+/* in flight.  inflight is the number of packets in flight */
+extern int cc_dupack(struct cc *c, int inflight);
+
+/* a retransmission timer expired with inflight packets in flight */
+extern void cc_timeout(struct cc *c, int inflight);
+
+/* the most packets that may be in flight now */
+#define cc_window(c) ((c)->kind == CC_NONE ? (c)->maxwindow : (int)(c)->cwnd)
+
+/* the CC_ kind called name, -1 if there is none */
+extern int cc_byname(const char *name);
+extern const char *cc_name(int kind);
+
+#endif
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include "channel.h"
+#include "emulator.h"
+
+static const char *const lossnames[] = { "iid", "gilbert" };
+static const char *const delaynames[] = { "uniform", "link" };
+
+static int inrange(const char *name, float x)
+{
+  if (x >= 0 && x <= 1)
+    return 1;
+  fprintf(stderr, "%s must be a probability, 0 to 1\n", name);
+  return 0;
+}
+
+int chanmodel_init(struct chanmodel *m, const struct sim_params *p)
+{
+  if (!inrange("ge-enter", p->geenter) || !inrange("ge-leave", p->geleave) ||
+      !inrange("ge-loss", p->geloss) || !inrange("reorder", p->reorder))
+    return -1;
+  if (p->delaymodel == CHAN_DELAY_LINK && (p->linkrate <= 0 || p->propdelay < 0)) {
+    fprintf(stderr, "the link needs a link-rate above 0 and a prop-delay of at least 0\n");
+    return -1;
+  }
+  if (p->queuelimit < 0 || p->reorderdelay < 0) {
+    fprintf(stderr, "queue-limit and reorder-delay must not be negative\n");
+    return -1;
+  }
+  m->loss = p->lossmodel;
+  m->delay = p->delaymodel;
+  m->lossin[0] = p->lossprob;
+  m->lossin[1] = p->geloss;
+  m->toggle[0] = p->geenter;
+  m->toggle[1] = p->geleave;
+  m->perbyte = 1 / p->linkrate;
+  m->minsend = offsetof(struct pkt, payload) * m->perbyte;
+  m->prop = p->propdelay;
+  m->queuelimit = p->queuelimit;
+  m->reorder = p->reorder;
+  m->reorderdelay = p->reorderdelay;
+  return 0;
+}
+
+void channel_init(struct channel *c, float *queue)
+{
+  c->last = 0.0;
+  c->bad = 0;
+  c->queue = queue;
+  c->qhead = c->qcount = 0;
+}
+
+int channel_send(struct simulation *sim, struct channel *c, int flow, float t,
+                 int size, int lossy, float *arrival, double *busy)
+{
+  const struct chanmodel *m = &sim->chan;
+  float start, leave;
+  int lost;
+
+  if (m->loss == CHAN_LOSS_GILBERT && lossy) {
+    lost = jimsrand(sim, flow, RNG_LOSS) < m->lossin[c->bad];
+    if (jimsrand(sim, flow, RNG_LOSS) < m->toggle[c->bad])
+      c->bad = !c->bad;
+    if (lost)
+      return CHAN_LOST;
+  }
+  if (m->queuelimit > 0) {
+    while (c->qcount > 0 && c->queue[c->qhead] <= t) {   /* gone by now */
+      c->qhead = (c->qhead + 1) % m->queuelimit;
+      c->qcount--;
+    }
+    if (c->qcount == m->queuelimit)
+      return CHAN_DROPPED;
+  }
+
+  start = t;
+  if (c->last > start)
+    start = c->last;
+  if (m->delay == CHAN_DELAY_LINK) {
+    leave = start + size * m->perbyte;
+    c->last = leave;
+    *arrival = leave + m->prop;
+    *busy += leave - start;
+  }
+  else {
+    *arrival = start + 1 + 9*jimsrand(sim, flow, RNG_DELAY);
+    leave = c->last = *arrival;
+    *busy += *arrival - start;  /* FIFO: no overlap to count twice */
+  }
+  if (m->queuelimit > 0)
+    c->queue[(c->qhead + c->qcount++) % m->queuelimit] = leave;
+  /* held back after c->last is set, so the packets behind overtake it */
+  if (m->reorder > 0 && jimsrand(sim, flow, RNG_DELAY) < m->reorder)
+    *arrival += m->reorderdelay * jimsrand(sim, flow, RNG_DELAY);
+  return CHAN_SENT;
+}
+
+float channel_lookahead(const struct chanmodel *m, const struct channel *c, float t)
+{
+  float start = (c->last > t) ? c->last : t, sent;
+
+  /* the same float operations channel_send() rounds, on smaller */
+  /* operands, so the bound cannot come out above a real arrival */
+  if (m->delay == CHAN_DELAY_LINK) {
+    sent = start + m->minsend;
+    return sent + m->prop;
+  }
+  return start + 1;
+}
+
+static int byname(const char *const *names, int n, const char *name)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    if (strcmp(names[i], name) == 0)
+      return i;
+  return -1;
+}
+
+int chanloss_byname(const char *name)
+{
+  return byname(lossnames, (int)(sizeof(lossnames) / sizeof(lossnames[0])), name);
+}
+
+int chandelay_byname(const char *name)
+{
+  return byname(delaynames, (int)(sizeof(delaynames) / sizeof(delaynames[0])), name);
+}
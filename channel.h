@@ -0,0 +1,102 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include "params.h"
+
+/* ******************************************************************
+   Channel models: what happens to a packet between tolayer3() and its
+   arrival at the other side, the "loss-model" and "delay-model"
+   parameters and the ones that follow them.
+
+   Loss, as the packet enters the channel:
+   CHAN_LOSS_IID      every packet is lost with probability loss, as
+                      before.
+   CHAN_LOSS_GILBERT  Gilbert-Elliott bursts.  The channel is in a good
+                      or a bad state; a packet is lost with probability
+                      loss in the good state and ge-loss in the bad one.
+                      After each packet the channel turns bad with
+                      probability ge-enter, or good again with ge-leave,
+                      so bad spells last 1/ge-leave packets on average.
+
+   Delay:
+   CHAN_DELAY_UNIFORM the original: a packet arrives 1 to 10 time units
+                      after the later of its sending and the arrival of
+                      the packet before it.
+   CHAN_DELAY_LINK    a link of link-rate bytes per time unit: packets
+                      are sent one after the other, each taking its
+                      size / link-rate, and arrive prop-delay after they
+                      have been sent.
+
+   queue-limit N bounds the packets waiting in a channel (for the link,
+   or with uniform delays on their way): a packet that finds N there is
+   dropped (tail drop).  reorder P holds a packet back, with probability
+   P, by up to reorder-delay time units past its arrival time, and the
+   packets behind it do not wait for it.
+
+   Every per-packet decision compares at most a few random draws with
+   thresholds chanmodel_init() works out once from the parameters, and
+   the queue is a ring of queue-limit departure times, so a packet
+   costs the same whatever the model.  The draws come from the sending
+   flow's streams: RNG_LOSS for loss and state changes, RNG_DELAY for
+   delays and reordering.
+**********************************************************************/
+
+#define CHAN_LOSS_IID       0
+#define CHAN_LOSS_GILBERT   1
+
+#define CHAN_DELAY_UNIFORM  0
+#define CHAN_DELAY_LINK     1
+
+/* the channel model of a run */
+struct chanmodel {
+  int loss;                 /* CHAN_LOSS_ kind */
+  int delay;                /* CHAN_DELAY_ kind */
+  float lossin[2];          /* loss probability in the good and the bad state */
+  float toggle[2];          /* probability of leaving the good and the bad state */
+  float perbyte;            /* link: time to send a byte, 1 / link-rate */
+  float minsend;            /* link: time to send a bare header */
+  float prop;               /* link: propagation delay */
+  int queuelimit;           /* packets, 0 for no limit */
+  float reorder;            /* probability of holding a packet back */
+  float reorderdelay;       /* for up to this long */
+};
+
+/* one direction of a channel */
+struct channel {
+  float last;               /* uniform: latest arrival scheduled; link: when */
+                            /* the link is free again */
+  int bad;                  /* Gilbert-Elliott: in the bad state */
+  float *queue;             /* when the queued packets leave the queue, a */
+  int qhead, qcount;        /* ring of queuelimit, NULL if unlimited */
+};
+
+/* outcomes of channel_send() */
+#define CHAN_SENT     0
+#define CHAN_LOST     1     /* in the Gilbert-Elliott model */
+#define CHAN_DROPPED  2     /* at a full queue */
+
+struct simulation;
+
+/* the model params describe.  returns -1 (after printing why) if */
+/* they are out of range */
+extern int chanmodel_init(struct chanmodel *m, const struct sim_params *p);
+
+/* an idle channel in the good state; queue has room for the model's */
+/* queuelimit times, or is NULL without a limit */
+extern void channel_init(struct channel *c, float *queue);
+
+/* sim's flow sends a packet of size bytes on c at time t; lossy is 0 */
+/* if loss does not apply in this direction.  returns CHAN_SENT, with  */
+/* the arrival time in *arrival and the time the packet kept c busy    */
+/* added to *busy, or CHAN_LOST or CHAN_DROPPED */
+extern int channel_send(struct simulation *sim, struct channel *c, int flow, float t,
+                        int size, int lossy, float *arrival, double *busy);
+
+/* the earliest a packet sent on c at time t or later can arrive */
+extern float channel_lookahead(const struct chanmodel *m, const struct channel *c, float t);
+
+/* the CHAN_LOSS_ and CHAN_DELAY_ kinds called name, -1 if there is none */
+extern int chanloss_byname(const char *name);
+extern int chandelay_byname(const char *name);
+
+#endif
@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+#include "protocol.h"
+
+#define CK_MAGIC    "SIMCKPT"
+#define CK_VERSION  4
+
+struct ckheader {
+  char magic[8];
+  uint32_t version;
+  uint32_t payloadmax;          /* PAYLOAD_MAX */
+  uint32_t sizes[4];            /* of the structs stored whole */
+  char protocol[32];            /* name of the protocol */
+};
+
+static void buildheader(struct ckheader *h)
+{
+  memset(h, 0, sizeof(*h));
+  memcpy(h->magic, CK_MAGIC, sizeof(h->magic));
+  h->version = CK_VERSION;
+  h->payloadmax = PAYLOAD_MAX;
+  h->sizes[0] = sizeof(struct pkt);
+  h->sizes[1] = sizeof(struct sim_params);
+  h->sizes[2] = sizeof(struct sim_stats);
+  h->sizes[3] = sizeof(struct rng);
+}
+
+/********************* WRITING *******/
+
+int ckwrite_open(struct ckwriter *w, const char *file, const struct sim_params *params)
+{
+  struct ckheader h;
+  struct sim_params p = *params;
+
+  snprintf(w->tmp, sizeof(w->tmp), "%s.tmp", file);
+  if ((w->fp = fopen(w->tmp, "wb")) == NULL) {
+    fprintf(stderr, "cannot create checkpoint %s\n", w->tmp);
+    return -1;
+  }
+  w->offset = 0;
+  w->failed = 0;
+  buildheader(&h);
+  snprintf(h.protocol, sizeof(h.protocol), "%s", params->protocol->name);
+  p.protocol = NULL;          /* stored by name */
+  ckwrite_put(w, &h, sizeof(h));
+  ckwrite_align(w);
+  ckwrite_put(w, &p, sizeof(p));
+  ckwrite_align(w);
+  return 0;
+}
+
+void ckwrite_put(struct ckwriter *w, const void *p, size_t n)
+{
+  if (n > 0 && fwrite(p, 1, n, w->fp) != n)
+    w->failed = 1;
+  w->offset += n;
+}
+
+void ckwrite_align(struct ckwriter *w)
+{
+  static const char zeros[8];
+
+  ckwrite_put(w, zeros, (8 - w->offset % 8) % 8);
+}
+
+int ckwrite_close(struct ckwriter *w, const char *file)
+{
+  if (fclose(w->fp) != 0)
+    w->failed = 1;
+  if (w->failed || rename(w->tmp, file) != 0) {
+    fprintf(stderr, "cannot write checkpoint %s\n", file);
+    remove(w->tmp);
+    return -1;
+  }
+  return 0;
+}
+
+/********************* READING *******/
+
+struct checkpoint *checkpoint_open(const char *file)
+{
+  struct checkpoint *ck;
+  struct ckheader h, want;
+  struct stat st;
+  void *image;
+  int fd;
+
+  if ((fd = open(file, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+    fprintf(stderr, "cannot read checkpoint %s\n", file);
+    if (fd >= 0)
+      close(fd);
+    return NULL;
+  }
+  if ((size_t)st.st_size < sizeof(h) + sizeof(struct sim_params)) {
+    fprintf(stderr, "%s is not a checkpoint\n", file);
+    close(fd);
+    return NULL;
+  }
+  image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED) {
+    fprintf(stderr, "cannot map checkpoint %s\n", file);
+    return NULL;
+  }
+
+  ck = malloc(sizeof(struct checkpoint));
+  if (ck == 0) {
+    printf("memory allocation for checkpoint failed.");
+    exit(EXIT_FAILURE);
+  }
+  ck->image = image;
+  ck->size = st.st_size;
+  memcpy(&h, image, sizeof(h));
+  buildheader(&want);
+  if (memcmp(h.magic, want.magic, sizeof(h.magic)) != 0 || h.version != want.version) {
+    fprintf(stderr, "%s is not a checkpoint of this version\n", file);
+    checkpoint_close(ck);
+    return NULL;
+  }
+  if (h.payloadmax != want.payloadmax || memcmp(h.sizes, want.sizes, sizeof(h.sizes)) != 0) {
+    fprintf(stderr, "%s was written by a different build (PAYLOAD_MAX %u)\n", file, h.payloadmax);
+    checkpoint_close(ck);
+    return NULL;
+  }
+  h.protocol[sizeof(h.protocol) - 1] = '\0';
+  ck->start = (sizeof(h) + 7) / 8 * 8;
+  memcpy(&ck->params, ck->image + ck->start, sizeof(struct sim_params));
+  ck->start += (sizeof(struct sim_params) + 7) / 8 * 8;
+  if ((ck->params.protocol = protocol_find(h.protocol)) == NULL) {
+    fprintf(stderr, "%s: unknown protocol %s\n", file, h.protocol);
+    checkpoint_close(ck);
+    return NULL;
+  }
+  ck->params.tracefile[0] = '\0';
+  ck->params.evlogfile[0] = '\0';
+  ck->params.statsjson[0] = '\0';
+  ck->params.checkpoint[0] = '\0';
+  ck->params.restore[0] = '\0';
+  ck->params.checkpointat = 0.0;
+  ck->params.checkpointevery = 0.0;
+  return ck;
+}
+
+void checkpoint_close(struct checkpoint *ck)
+{
+  munmap((void *)ck->image, ck->size);
+  free(ck);
+}
+
+void ckread_begin(struct ckreader *r, const struct checkpoint *ck)
+{
+  r->p = ck->image + ck->start;
+  r->end = ck->image + ck->size;
+}
+
+int ckread_copy(struct ckreader *r, void *dst, size_t n)
+{
+  if (n > (size_t)(r->end - r->p))
+    return -1;
+  memcpy(dst, r->p, n);
+  r->p += n;
+  return 0;
+}
+
+void ckread_align(struct ckreader *r)
+{
+  /* sections are aligned to the start of the image, which mmap aligns */
+  size_t pad = (8 - (uintptr_t)r->p % 8) % 8;
+
+  r->p = (pad > (size_t)(r->end - r->p)) ? r->end : r->p + pad;
+}
@@ -0,0 +1,74 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "emulator.h"
+
+/* ******************************************************************
+   Checkpoint files: the whole state of a running simulation, written
+   between two events and restored into a new simulation that carries
+   on exactly where the first one was (see sim_checkpoint() and
+   sim_restore() in emulator.h).
+
+   A checkpoint is a header, the parameters of the run and then the
+   emulator's sections, in the native byte order and struct layout of
+   the build that wrote it.  Every section starts at a multiple of 8
+   bytes, so a mapped file can be read in place.  The header records
+   PAYLOAD_MAX and the sizes of the structs that are stored whole, and
+   a build that differs refuses the file.  checkpoint_open() maps the
+   file read only, so one checkpoint can seed any number of
+   simulations, on any number of threads.
+
+   Files are written under a temporary name and renamed over file once
+   complete, so a run that dies while writing leaves the previous
+   checkpoint intact.
+**********************************************************************/
+
+/* a checkpoint being written */
+struct ckwriter {
+  FILE *fp;
+  char tmp[PARAM_STRLEN + 8];   /* file.tmp until it is complete */
+  long offset;                  /* bytes written so far */
+  int failed;
+};
+
+/* create file.tmp and write the header and params of a checkpoint. */
+/* returns -1 (after printing why) if it cannot be created */
+extern int ckwrite_open(struct ckwriter *w, const char *file, const struct sim_params *params);
+
+/* append n bytes; ckwrite_align() pads to the next multiple of 8 */
+extern void ckwrite_put(struct ckwriter *w, const void *p, size_t n);
+extern void ckwrite_align(struct ckwriter *w);
+
+/* finish the checkpoint and rename it to file.  returns -1 (after */
+/* printing why) if any write failed; file is then left as it was  */
+extern int ckwrite_close(struct ckwriter *w, const char *file);
+
+/* a checkpoint file mapped into memory */
+struct checkpoint {
+  const char *image;
+  size_t size;
+  size_t start;                 /* offset of the emulator's sections */
+  struct sim_params params;     /* of the run that wrote it, see checkpoint_open() */
+};
+
+/* map the checkpoint file.  params gets the parameters of the run that */
+/* wrote it, with the file names of its outputs (trace, event log, JSON */
+/* statistics and checkpoints) cleared.  returns NULL (after printing  */
+/* why) if the file cannot be read or was written by a different build */
+extern struct checkpoint *checkpoint_open(const char *file);
+extern void checkpoint_close(struct checkpoint *ck);
+
+/* reads the sections of a checkpoint in order, bounds checked */
+struct ckreader {
+  const char *p, *end;
+};
+
+extern void ckread_begin(struct ckreader *r, const struct checkpoint *ck);
+
+/* copy the next n bytes to dst; returns -1 if the file ends first */
+extern int ckread_copy(struct ckreader *r, void *dst, size_t n);
+extern void ckread_align(struct ckreader *r);
+
+#endif
@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "checksum.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define HAVE_CRC_SSE42        /* compiled for sse4.2, used if the CPU has it */
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define HAVE_CRC_ARMV8
+#endif
+
+/* the sequence number the 16-bit checksum can't tell from the */
+/* emulator's corrupted 999999: 999999 mod 65535 */
+#define INET_ALIAS  16974
+
+#define CRC32C_POLY  0x82f63b78     /* reflected Castagnoli polynomial */
+
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static uint32_t crctable[8][256];
+static uint32_t (*crcupdate)(uint32_t crc, const unsigned char *b, size_t n);
+static const char *crcimpl;
+
+static const char *const names[] = { "sum", "inet", "crc32c" };
+
+/********************* CKSUM_SUM *******/
+
+static uint32_t sum(const struct pkt *p)
+{
+  int checksum;
+  int i;
+
+  checksum = p->seqnum;
+  checksum += p->acknum;
+  for (i = 0; i < p->length; i++)
+    checksum += (int)(p->payload[i]);
+  return (uint32_t)checksum;
+}
+
+/********************* CKSUM_INET *******/
+
+/* add the n bytes at b to acc as 32-bit words.  the sum folds to the */
+/* same 16-bit ones' complement sum as adding 16-bit words would, in */
+/* either byte order, as long as every word starts at an even offset */
+static uint64_t add32(uint64_t acc, const unsigned char *b, size_t n)
+{
+  uint64_t w, lanes[2];
+
+#if defined(__SSE2__)
+  __m128i zero = _mm_setzero_si128(), vacc = zero, v;
+
+  /* 16 bytes a step: zero-extend the four words into two 64-bit lanes */
+  for (; n >= 16; b += 16, n -= 16) {
+    v = _mm_loadu_si128((const __m128i *)b);
+    vacc = _mm_add_epi64(vacc, _mm_unpacklo_epi32(v, zero));
+    vacc = _mm_add_epi64(vacc, _mm_unpackhi_epi32(v, zero));
+  }
+  _mm_storeu_si128((__m128i *)lanes, vacc);
+  acc += lanes[0] + lanes[1];
+#elif defined(__ARM_NEON)
+  uint64x2_t vacc = vdupq_n_u64(0);
+
+  /* 16 bytes a step: add pairs of words into two 64-bit lanes */
+  for (; n >= 16; b += 16, n -= 16)
+    vacc = vpadalq_u32(vacc, vreinterpretq_u32_u8(vld1q_u8(b)));
+  vst1q_u64(lanes, vacc);
+  acc += lanes[0] + lanes[1];
+#else
+  (void)lanes;
+#endif
+
+  for (; n >= 8; b += 8, n -= 8) {
+    memcpy(&w, b, 8);
+    acc += (w & 0xffffffff) + (w >> 32);
+  }
+  if (n > 0) {              /* the last bytes, padded with zeros */
+    w = 0;
+    memcpy(&w, b, n);
+    acc += (w & 0xffffffff) + (w >> 32);
+  }
+  return acc;
+}
+
+static uint32_t inet(const struct pkt *p)
+{
+  uint64_t acc;
+
+  acc = (uint64_t)(uint32_t)p->seqnum + (uint32_t)p->acknum + (uint32_t)p->length +
+        (uint32_t)p->flags;
+  acc = add32(acc, (const unsigned char *)p->payload, p->length);
+  while (acc >> 16)
+    acc = (acc & 0xffff) + (acc >> 16);
+  return ~acc & 0xffff;
+}
+
+/********************* CKSUM_CRC32C *******/
+
+/* slicing by 8: eight bytes a step through eight tables */
+static uint32_t crc_table(uint32_t crc, const unsigned char *b, size_t n)
+{
+  uint32_t lo, hi;
+
+  for (; n >= 8; b += 8, n -= 8) {
+    lo = crc ^ (b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24);
+    hi = b[4] | (uint32_t)b[5] << 8 | (uint32_t)b[6] << 16 | (uint32_t)b[7] << 24;
+    crc = crctable[7][lo & 0xff] ^ crctable[6][(lo >> 8) & 0xff] ^
+          crctable[5][(lo >> 16) & 0xff] ^ crctable[4][lo >> 24] ^
+          crctable[3][hi & 0xff] ^ crctable[2][(hi >> 8) & 0xff] ^
+          crctable[1][(hi >> 16) & 0xff] ^ crctable[0][hi >> 24];
+  }
+  for (; n > 0; b++, n--)
+    crc = crctable[0][(crc ^ *b) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+#ifdef HAVE_CRC_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t crc_sse42(uint32_t crc, const unsigned char *b, size_t n)
+{
+  uint64_t c = crc, w;
+
+  for (; n >= 8; b += 8, n -= 8) {
+    memcpy(&w, b, 8);
+    c = _mm_crc32_u64(c, w);
+  }
+  crc = (uint32_t)c;
+  for (; n > 0; b++, n--)
+    crc = _mm_crc32_u8(crc, *b);
+  return crc;
+}
+#endif
+
+#ifdef HAVE_CRC_ARMV8
+static uint32_t crc_armv8(uint32_t crc, const unsigned char *b, size_t n)
+{
+  uint64_t w;
+
+  for (; n >= 8; b += 8, n -= 8) {
+    memcpy(&w, b, 8);
+    crc = __crc32cd(crc, w);
+  }
+  for (; n > 0; b++, n--)
+    crc = __crc32cb(crc, *b);
+  return crc;
+}
+#endif
+
+static uint32_t crc32c(const struct pkt *p)
+{
+  unsigned char header[4 * sizeof(int)];
+  uint32_t crc = 0xffffffff;
+
+  /* the checksum field sits between acknum and length, so gather them */
+  memcpy(header, &p->seqnum, sizeof(int));
+  memcpy(header + sizeof(int), &p->acknum, sizeof(int));
+  memcpy(header + 2 * sizeof(int), &p->length, sizeof(int));
+  memcpy(header + 3 * sizeof(int), &p->flags, sizeof(int));
+  crc = crcupdate(crc, header, sizeof(header));
+  crc = crcupdate(crc, (const unsigned char *)p->payload, p->length);
+  return ~crc;
+}
+
+static void setup(void)
+{
+  uint32_t c;
+  int i, j;
+
+  crcupdate = crc_table;
+  crcimpl = "table";
+#ifdef HAVE_CRC_SSE42
+  if (__builtin_cpu_supports("sse4.2")) {
+    crcupdate = crc_sse42;
+    crcimpl = "sse4.2";
+  }
+#endif
+#ifdef HAVE_CRC_ARMV8
+  crcupdate = crc_armv8;
+  crcimpl = "armv8";
+#endif
+  if (crcupdate != crc_table)
+    return;
+
+  for (i = 0; i < 256; i++) {
+    c = i;
+    for (j = 0; j < 8; j++)
+      c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+    crctable[0][i] = c;
+  }
+  for (i = 0; i < 256; i++)
+    for (j = 1; j < 8; j++)
+      crctable[j][i] = (crctable[j - 1][i] >> 8) ^ crctable[0][crctable[j - 1][i] & 0xff];
+}
+
+void checksum_init(void)
+{
+  pthread_once(&once, setup);
+}
+
+uint32_t checksum_compute(int kind, const struct pkt *p)
+{
+  switch (kind) {
+  case CKSUM_INET:
+    return inet(p);
+  case CKSUM_CRC32C:
+    return crc32c(p);
+  default:
+    return sum(p);
+  }
+}
+
+int checksum_usable(int kind, int seqspace)
+{
+  if (kind == CKSUM_INET && seqspace > INET_ALIAS) {
+    fprintf(stderr, "the inet checksum misses corrupted sequence numbers once there are more than %d, "
+            "use --checksum crc32c\n", INET_ALIAS);
+    return -1;
+  }
+  return 0;
+}
+
+int checksum_byname(const char *name)
+{
+  int i;
+
+  for (i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++)
+    if (strcmp(names[i], name) == 0)
+      return i;
+  return -1;
+}
+
+const char *checksum_name(int kind)
+{
+  if (kind < 0 || kind >= (int)(sizeof(names) / sizeof(names[0])))
+    return "?";
+  return names[kind];
+}
+
+const char *checksum_crcimpl(void)
+{
+  checksum_init();
+  return crcimpl;
+}
@@ -0,0 +1,51 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdint.h>
+#include "emulator.h"
+
+/* ******************************************************************
+   Packet checksums, the "checksum" parameter.
+
+   Every kind covers seqnum, acknum and the payload bytes in use; the
+   two strong kinds also cover the length and flags.
+
+   CKSUM_SUM     the original sum of the header fields and the payload
+                 bytes, kept so old runs can be reproduced exactly.  It
+                 misses swapped bytes and changes that cancel out.
+   CKSUM_INET    the 16-bit ones' complement Internet checksum (RFC 1071),
+                 summed 32 bits at a time into 64-bit accumulators.
+   CKSUM_CRC32C  CRC-32C (Castagnoli), with the SSE4.2 or ARMv8 CRC
+                 instructions where the CPU has them, otherwise sliced
+                 by 8 through tables.
+
+   All three catch every corruption the emulator applies: a changed
+   first payload byte, or seqnum or acknum set to 999999.  The 16-bit
+   checksum sums seqnum in 16-bit halves, so it cannot tell 999999 from
+   999999 mod 65535 = 16974; sequence spaces that reach that number are
+   refused with it (see checksum_usable()).
+**********************************************************************/
+
+#define CKSUM_SUM      0
+#define CKSUM_INET     1
+#define CKSUM_CRC32C   2
+
+/* set up the tables and pick the CRC implementation; safe to call from */
+/* several threads, only the first call does anything */
+extern void checksum_init(void);
+
+/* checksum of kind over packet p, checksum_init() having been called */
+extern uint32_t checksum_compute(int kind, const struct pkt *p);
+
+/* 0 if kind catches every corruption of the emulator with seqspace */
+/* sequence numbers, -1 after printing why not */
+extern int checksum_usable(int kind, int seqspace);
+
+/* the CKSUM_ kind called name, -1 if there is none */
+extern int checksum_byname(const char *name);
+extern const char *checksum_name(int kind);
+
+/* how CRC-32C is computed on this machine: "sse4.2", "armv8" or "table" */
+extern const char *checksum_crcimpl(void);
+
+#endif
@@ -36,443 +36,1476 @@
    ********************************************************************* */
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include "emulator.h"
-#include "gbn.h"
+#include "backlog.h"
+#include "bench.h"
+#include "cc.h"
+#include "checkpoint.h"
+#include "checksum.h"
+#include "evlog.h"
+#include "pdes.h"
+#include "protocol.h"
+#include "sweep.h"
+#include "udp.h"
 
 struct event {
   float evtime;           /* event time */
   int evtype;             /* event type code */
   int eventity;           /* entity where event occurs */
-  struct pkt *pktptr;     /* ptr to packet (if any) assoc w/ this event */
-  struct event *prev;
-  struct event *next;
+  unsigned long evseq;    /* insertion order, breaks ties between equal evtimes */
+  struct event *nextfree; /* next node on the pool free list */
+  struct pkt pkt;         /* the packet in flight (FROM_LAYER3 events only), */
+                          /* last so only the bytes in use are touched */
 };
 
-struct event *evlist = NULL;   /* the event list */
+/* events are carved out of slabs and recycled through a free list, so */
+/* the main loop does no malloc/free per packet, timer or arrival.     */
+/* an event ends with only as much packet as the run's carry (see     */
+/* pkt_stride()), so slabs hold EVSLAB_SIZE of them evstride() apart. */
+#define  EVSLAB_SIZE     1024
+
+struct evslab {
+  struct evslab *next;  /* followed by the events */
+};
+
+#define  evstride(sim)        ((offsetof(struct event, pkt) + (sim)->pktstride + 7) / 8 * 8)
+#define  slabevent(slab, stride, i) \
+  ((struct event *)((char *)((slab) + 1) + (size_t)(i) * (stride)))
+
+/* the event list sim->evheap is a 4-ary min-heap of event pointers
+   ordered on (evtime, flow, evseq), so events with the same time come
+   out flow by flow, and in the order they were inserted within a flow.
+   sim->evheap[0] is always the next event to simulate.  sim->timerev[]
+   holds the pending TIMER_INTERRUPT event of each entity (NULL when the
+   timer is off), and sim->channels[] the state of each channel (see
+   channel.h): the one to each entity, or with a shared bottleneck the
+   one to each side. */
+#define  EVHEAP_ARITY    4
 
 /* possible events: */
 #define  TIMER_INTERRUPT 0  
 #define  FROM_LAYER5     1
 #define  FROM_LAYER3     2
+#define  TIMER_CANCELLED 3   /* tombstone left in the heap by stoptimer() */
 
 #define  OFF             0
 #define  ON              1
 
-int TRACE = 3;
-
-/* statistics updated by GBN */
-int window_full;   /* count of the number of messages dropped due to full window */
-int total_ACKs_received;
-int packets_resent;       /* count of the number of packets resent  */
-int new_ACKs;           /* count of the number of acks correctly received */
-int packets_received;  /* count of the packets received by receiver */
-
-/* statistics updated by emulator */
-static int packets_lost;  
-static int packets_corrupt;
-static int packets_sent;
-static int packets_timeout;
-static int messages_delivered;
-
-static int nsim = 0;              /* number of messages from 5 to 4 so far */ 
-static int nsimmax = 0;           /* number of msgs to generate, then stop */
-static float time = 0.000;
-static float lossprob;            /* probability that a packet is dropped  */
-static float corruptprob;   /* probability that one bit is packet is flipped */
-static int corruptdirection; /* A->B A<-B or bidirectional corruption/loss */
-static float lambda;        /* arrival rate of messages from layer 5 */   
-static int   ntolayer3;           /* number sent into layer 3 */
-static int   nlost;               /* number lost in media */
-static int ncorrupt;              /* number corrupted by media*/
-
 /****************************************************************************/
-/* jimsrand(): return a double in range [0,1].  The routine below is used to */
-/* isolate all random number generation in one location.  We assume that the*/
-/* system-supplied rand() function return an int in therange [0,mmm]        */
+/* jimsrand(): return a double in range [0,1).  The routine below is used to*/
+/* isolate all random number generation in one location.  Each caller draws */
+/* from its flow's stream for its kind of decision (RNG_LOSS, RNG_DELAY, ...)*/
 /****************************************************************************/
-double jimsrand(void) 
+double jimsrand(struct simulation *sim, int flow, int stream) 
 {
-  double mmm = RAND_MAX;     /* largest int  - MACHINE DEPENDENT!!!!!!!!   */
   double x;                   
-  x = rand()/mmm;            /* x should be uniform in [0,1] */
-  if (TRACE > 3)
-    printf("RANDOM NUMBER GENERAION CALLED: %f\n", x);
+  x = rng_uniform(&sim->streams[flow * NUM_RNG + stream]);  /* x should be uniform in [0,1) */
+  if (TRACING(sim, 4))
+    trace_printf(sim, "RANDOM NUMBER GENERAION CALLED: %f\n", x);
   return(x);
 }  
 
-/********************* EVENT HANDLINE ROUTINES *******/
-/*  The next set of routines handle the event list   */
-/*****************************************************/
+/********************* EVENT POOL ROUTINES *******/
 
-void insertevent(struct event *p)
+/* take an event from the pool, adding a new slab if it is empty */
+static struct event *allocevent(struct simulation *sim)
 {
-  struct event *q,*qold;
+  const size_t stride = evstride(sim);
+  struct evslab *slab;
+  struct event *p;
+  int i;
 
-  if (TRACE>2) {
-    printf("            INSERTEVENT: time is %f\n",time);
-    printf("            INSERTEVENT: future time will be %f\n",p->evtime); 
-  }
-  q = evlist;     /* q points to front of list in which p struct inserted */
-  if (q==NULL) {   /* list is empty */
-    evlist=p;
-    p->next=NULL;
-    p->prev=NULL;
-  }
-  else {
-    for (qold = q; q !=NULL && p->evtime > q->evtime; q=q->next)
-      qold=q; 
-    if (q==NULL) {   /* end of list */
-      qold->next = p;
-      p->prev = qold;
-      p->next = NULL;
+  if (sim->evfree == NULL) {
+    slab = malloc(sizeof(struct evslab) + EVSLAB_SIZE * stride);
+    if (slab == 0) {
+      printf("memory allocation for event failed.");
+      exit(EXIT_FAILURE);
     }
-    else if (q==evlist) { /* front of list */
-      p->next=evlist;
-      p->prev=NULL;
-      p->next->prev=p;
-      evlist = p;
+    slab->next = sim->evslabs;
+    sim->evslabs = slab;
+    for (i = EVSLAB_SIZE - 1; i >= 0; i--) {
+      p = slabevent(slab, stride, i);
+      p->nextfree = sim->evfree;
+      sim->evfree = p;
     }
-    else {     /* middle of list */
-      p->next=q;
-      p->prev=q->prev;
-      q->prev->next=p;
-      q->prev=p;
+  }
+  p = sim->evfree;
+  sim->evfree = p->nextfree;
+  return p;
+}
+
+/* return an event to the pool */
+static void freeevent(struct simulation *sim, struct event *p)
+{
+  p->nextfree = sim->evfree;
+  sim->evfree = p;
+}
+
+/* release every slab and empty the event list, ready for a new run */
+static void resetevents(struct simulation *sim)
+{
+  struct evslab *slab;
+  int i;
+
+  while (sim->evslabs != NULL) {
+    slab = sim->evslabs;
+    sim->evslabs = slab->next;
+    free(slab);
+  }
+  sim->evfree = NULL;
+  sim->evcount = 0;
+  sim->evseqnext = 0;
+  for (i = 0; i < sim->nentities; i++)
+    sim->timerev[i] = NULL;
+}
+
+/* true if event a must be simulated before event b */
+static int evbefore(const struct event *a, const struct event *b)
+{
+  if (a->evtime != b->evtime)
+    return (a->evtime < b->evtime);
+  if (entity_flow(a->eventity) != entity_flow(b->eventity))
+    return (entity_flow(a->eventity) < entity_flow(b->eventity));
+  return (a->evseq < b->evseq);
+}
+
+/* move event p up from slot hole until its parent comes before it */
+static void siftup(struct simulation *sim, int hole, struct event *p)
+{
+  int parent;
+
+  while (hole > 0) {
+    parent = (hole - 1) / EVHEAP_ARITY;
+    if (!evbefore(p, sim->evheap[parent]))
+      break;
+    sim->evheap[hole] = sim->evheap[parent];
+    hole = parent;
+  }
+  sim->evheap[hole] = p;
+}
+
+/* move event p down from slot hole until no child comes before it */
+static void siftdown(struct simulation *sim, int hole, struct event *p)
+{
+  int child, best, end;
+
+  while ((child = EVHEAP_ARITY*hole + 1) < sim->evcount) {
+    best = child;
+    end = (child + EVHEAP_ARITY < sim->evcount) ? child + EVHEAP_ARITY : sim->evcount;
+    for (child++; child < end; child++)
+      if (evbefore(sim->evheap[child], sim->evheap[best]))
+        best = child;
+    if (!evbefore(sim->evheap[best], p))
+      break;
+    sim->evheap[hole] = sim->evheap[best];
+    hole = best;
+  }
+  sim->evheap[hole] = p;
+}
+
+/* add event p, which has its evseq already, to the heap */
+static void pushevent(struct simulation *sim, struct event *p)
+{
+  struct event **newheap;
+
+  if (sim->evcount == sim->evcapacity) {   /* heap is full, grow it */
+    sim->evcapacity = (sim->evcapacity == 0) ? 64 : 2*sim->evcapacity;
+    newheap = realloc(sim->evheap, sim->evcapacity * sizeof(struct event *));
+    if (newheap == 0) {
+      printf("memory allocation for event list failed.");
+      exit(EXIT_FAILURE);
     }
+    sim->evheap = newheap;
   }
+  siftup(sim, sim->evcount++, p);
 }
 
-void generate_next_arrival(void)
+static void insertevent(struct simulation *sim, struct event *p)
+{
+  if (TRACING(sim, 3)) {
+    trace_printf(sim, "            INSERTEVENT: time is %f\n",sim->time);
+    trace_printf(sim, "            INSERTEVENT: future time will be %f\n",p->evtime); 
+  }
+  p->evseq = sim->evseqnext++;
+  pushevent(sim, p);
+}
+
+/* remove and return the event in heap slot i */
+static struct event *removeevent(struct simulation *sim, int i)
+{
+  struct event *p, *last;
+
+  p = sim->evheap[i];
+  last = sim->evheap[--sim->evcount];
+  if (i < sim->evcount) {    /* refill the slot with the last event */
+    if (i > 0 && evbefore(last, sim->evheap[(i - 1) / EVHEAP_ARITY]))
+      siftup(sim, i, last);
+    else
+      siftdown(sim, i, last);
+  }
+  return p;
+}
+
+/* remove and return the next event to simulate, NULL if there are none */
+static struct event *popevent(struct simulation *sim)
+{
+  if (sim->evcount == 0)
+    return NULL;
+  return removeevent(sim, 0);
+}
+
+/* flow's share of the params.nsimmax messages */
+static int flowquota(const struct sim_params *p, int flow)
+{
+  return p->nsimmax / p->flows + (flow < p->nsimmax % p->flows);
+}
+
+/* the next layer 5 arrival of flow, at its A or B side */
+static void generate_next_arrival(struct simulation *sim, int flow)
 {
   double x;
   struct event *evptr;
 
-  if (TRACE>2)
-    printf("          GENERATE NEXT ARRIVAL: creating new arrival\n");
+  if (TRACING(sim, 3))
+    trace_printf(sim, "          GENERATE NEXT ARRIVAL: creating new arrival\n");
  
-  x = lambda*jimsrand()*2;  /* x is uniform on [0,2*lambda] */
+  x = sim->params.lambda*jimsrand(sim, flow, RNG_ARRIVAL)*2;  /* x is uniform on [0,2*lambda] */
   /* having mean of lambda        */
-  evptr = malloc(sizeof(struct event));
-  if (evptr == 0) {
-    printf("memory allocation for event failed.");
-    exit(EXIT_FAILURE);
-  }
-  evptr->evtime =  time + x;
+  evptr = allocevent(sim);
+  evptr->evtime =  sim->time + x;
   evptr->evtype =  FROM_LAYER5;
-  if (BIDIRECTIONAL && (jimsrand()>0.5) )
-    evptr->eventity = B;
+  if (sim->params.bidirectional && (jimsrand(sim, flow, RNG_ARRIVAL)>0.5) )
+    evptr->eventity = entity_of(flow, B);
   else
-    evptr->eventity = A;
-  insertevent(evptr);
+    evptr->eventity = entity_of(flow, A);
+  insertevent(sim, evptr);
 } 
 
-void printevlist(void)
+void printevlist(struct simulation *sim)
 {
   struct event *q;
-  printf("--------------\nEvent List Follows:\n");
-  for(q = evlist; q!=NULL; q=q->next) {
-    printf("Event time: %f, type: %d entity: %d\n",q->evtime,q->evtype,q->eventity);
+  int i;
+  trace_printf(sim, "--------------\nEvent List Follows (heap order, not time order):\n");
+  for(i = 0; i < sim->evcount; i++) {
+    q = sim->evheap[i];
+    trace_printf(sim, "Event time: %f, type: %d entity: %d\n",q->evtime,q->evtype,q->eventity);
   }
-  printf("--------------\n");
+  trace_printf(sim, "--------------\n");
 }
 
-void init(void)                         /* initialize the simulator */
+/* the first checkpoint params ask for after time t, 0 if there is none */
+static double nextcheckpoint(const struct sim_params *p, double t)
 {
-  float sum, avg;
-  int i;
+  double next = 0.0, k;
 
-  printf("-----  Stop and Wait Network Simulator Version 1.1 -------- \n\n");
-  printf("Enter the number of messages to simulate: ");
-  scanf("%d",&nsimmax);
-  printf("Enter  packet loss probability [enter 0.0 for no loss]:");
-  scanf("%f",&lossprob);
-  printf("Enter packet corruption probability [0.0 for no corruption]:");
-  scanf("%f",&corruptprob);
-  if (lossprob != 0.0 || corruptprob != 0.0) {
-    printf("If you want loss or corruption to only occur in one direction, choose the direction: 0 A->B, 1 A<-B, 2 A<->B (both directions) :");
-    scanf("%d",&corruptdirection);
-  }
-  printf("Enter average time between messages from sender's layer5 [ > 0.0]:");
-  scanf("%f",&lambda);
-  printf("Enter TRACE:");
-  scanf("%d",&TRACE);
-
-
-  srand(9999);              /* init random number generator */
-  sum = 0.0;                /* test random number generator for students */
-  for (i=0; i<1000; i++)
-    sum+=jimsrand();    /* jimsrand() should be uniform in [0,1] */
-  avg = sum/1000.0;
-  if (avg < 0.25 || avg > 0.75) {
-    printf("It is likely that random number generation on your machine\n" ); 
-    printf("is different from what this emulator expects.  Please take\n");
-    printf("a look at the routine jimsrand() in the emulator code. Sorry. \n");
+  if (p->checkpoint[0] == '\0')
+    return 0.0;
+  if (p->checkpointat > t)
+    next = p->checkpointat;
+  if (p->checkpointevery > 0) {
+    k = (floor(t / p->checkpointevery) + 1) * p->checkpointevery;
+    if (next == 0.0 || k < next)
+      next = k;
+  }
+  return next;
+}
+
+/* a simulation with everything but its events and protocol state, */
+/* NULL (after printing why) if params are invalid */
+static struct simulation *newsim(const struct sim_params *params)
+{
+  struct simulation *sim;
+  char *arrays;
+  int i, n;
+
+  sim = calloc(1, sizeof(struct simulation));
+  if (sim == 0) {
+    printf("memory allocation for simulation failed.");
+    exit(EXIT_FAILURE);
+  }
+  sim->params = *params;
+  if (params->payload < 1 || params->payload > PAYLOAD_MAX) {
+    fprintf(stderr, "payload must be 1 to %d bytes\n", PAYLOAD_MAX);
+    free(sim);
+    return NULL;
+  }
+  if (params->burst < 1) {
+    fprintf(stderr, "burst must be at least 1\n");
+    free(sim);
+    return NULL;
+  }
+  if (params->backlog < 0) {
+    fprintf(stderr, "backlog must not be negative\n");
+    free(sim);
+    return NULL;
+  }
+  if (params->flows < 1 || params->flows > MAX_FLOWS) {
+    fprintf(stderr, "flows must be 1 to %d\n", MAX_FLOWS);
+    free(sim);
+    return NULL;
+  }
+  if (chanmodel_init(&sim->chan, params) < 0) {
+    free(sim);
+    return NULL;
+  }
+  if (params->partitions < 1 || params->partitions > PDES_MAXPARTS) {
+    fprintf(stderr, "partitions must be 1 to %d\n", PDES_MAXPARTS);
+    free(sim);
+    return NULL;
+  }
+  if (params->partitions > 1 && (params->trace > 0 || params->evlogfile[0] != '\0' ||
+                                 params->checkpoint[0] != '\0')) {
+    /* their output follows the order of all events, which only one */
+    /* event loop has */
+    fprintf(stderr, "traces, event logs and checkpoints need partitions=1\n");
+    free(sim);
+    return NULL;
+  }
+  if (sim->params.protocol->configure(&sim->params) < 0 ||
+      checksum_usable(sim->params.checksum, sim->params.seqspace) < 0) {
+    free(sim);
+    return NULL;
+  }
+  checksum_init();
+  sim->msgstride = msg_stride(&sim->params);
+  sim->pktstride = pkt_stride(&sim->params);
+  if (trace_open(&sim->trace, params->tracefile) < 0) {
+    free(sim);
+    return NULL;
+  }
+  if (params->evlogfile[0] != '\0' &&
+      (sim->evlog = evlog_open(params->evlogfile)) == NULL) {
+    trace_close(&sim->trace);
+    free(sim);
+    return NULL;
+  }
+
+  sim->msgs = malloc(params->burst * sim->msgstride);
+  if (sim->msgs == 0) {
+    printf("memory allocation for messages failed.");
+    exit(EXIT_FAILURE);
+  }
+
+  /* the protocol state of every entity, one block the protocol lays out */
+  sim->state = calloc(1, sim->params.protocol->statesize(&sim->params));
+  if (sim->state == 0) {
+    printf("memory allocation for entity state failed.");
+    exit(EXIT_FAILURE);
+  }
+  sim->params.protocol->relink(sim);
+
+  /* the per-entity and per-flow arrays, one block, widest elements first */
+  n = sim->nentities = 2 * params->flows;
+  arrays = calloc(1, n * (sizeof(struct timeq) + sizeof(struct channel) +
+                          sizeof(struct backlog *) + sizeof(struct event *)) +
+                     params->flows * (sizeof(struct flowsums) + NUM_RNG * sizeof(struct rng) +
+                                      2 * sizeof(int)));
+  if (arrays == 0) {
+    printf("memory allocation for entities failed.");
     exit(EXIT_FAILURE);
   }
+  sim->sent = (struct timeq *)arrays;
+  arrays += n * sizeof(struct timeq);
+  sim->channels = (struct channel *)arrays;
+  arrays += n * sizeof(struct channel);
+  sim->backlog = (struct backlog **)arrays;
+  arrays += n * sizeof(struct backlog *);
+  sim->timerev = (struct event **)arrays;
+  arrays += n * sizeof(struct event *);
+  sim->sums = (struct flowsums *)arrays;
+  arrays += params->flows * sizeof(struct flowsums);
+  sim->streams = (struct rng *)arrays;
+  arrays += params->flows * NUM_RNG * sizeof(struct rng);
+  sim->delivered = (int *)arrays;
+  arrays += params->flows * sizeof(int);
+  sim->generated = (int *)arrays;
 
-  /* initialise statistics */
-  window_full = 0;
-  total_ACKs_received = 0;
-  packets_resent = 0;
-  new_ACKs = 0;
-  packets_received = 0;
-  packets_lost = 0;  
-  packets_corrupt = 0;
-  packets_sent = 0;
-  packets_timeout = 0;
-  messages_delivered = 0;
+  /* init random number generators, flow 0's as streams 0 .. NUM_RNG - 1 */
+  rng_seed_streams(sim->streams, params->flows * NUM_RNG, params->rngkind, params->seed);
+  if (params->rngselftest) {  /* test random number generator for students */
+    for (i=0; i<NUM_RNG; i++)
+      if (!rng_selftest(&sim->streams[i], 1000)) {
+        printf("It is likely that random number generation on your machine\n" ); 
+        printf("is different from what this emulator expects.  Please take\n");
+        printf("a look at the routine jimsrand() in the emulator code. Sorry. \n");
+        sim_destroy(sim);
+        return NULL;
+      }
+  }
 
-  ntolayer3 = 0;
-  nlost = 0;
-  ncorrupt = 0;
+  if (params->queuelimit > 0) {
+    sim->queues = malloc(n * params->queuelimit * sizeof(float));
+    if (sim->queues == 0) {
+      printf("memory allocation for channel queues failed.");
+      exit(EXIT_FAILURE);
+    }
+  }
+  for (i = 0; i < n; i++)
+    channel_init(&sim->channels[i], sim->queues ? sim->queues + i * params->queuelimit : NULL);
+  if (params->backlog > 0)
+    for (i = 0; i < n; i++)
+      if (entity_side(i) == A || params->bidirectional)
+        sim->backlog[i] = backlog_create(params->backlog, sim->msgstride);
+  return sim;
+}
 
-  time=0.0;                    /* initialize time to 0.0 */
-  generate_next_arrival();     /* initialize event list */
+struct simulation *sim_create(const struct sim_params *params)  /* initialize the simulator */
+{
+  struct simulation *sim;
+  int i;
+
+  if ((sim = newsim(params)) == NULL)
+    return NULL;
+
+  /* statistics, the event list and the timers all start out zeroed by calloc */
+  sim->nsim = 0;
+  sim->time=0.0;               /* initialize time to 0.0 */
+  for (i = 0; i < sim->params.flows; i++)
+    generate_next_arrival(sim, i);  /* initialize event list */
+
+  for (i = 0; i < sim->nentities; i++)
+    sim->params.protocol->init(sim, i);
+  sim->cknext = nextcheckpoint(&sim->params, 0.0);
+  return sim;
+}
+
+struct simulation *sim_attach(const struct sim_params *params, struct udplink *link)
+{
+  struct simulation *sim;
+  int i;
+
+  if ((sim = newsim(params)) == NULL)
+    return NULL;
+  sim->udp = link;              /* no events: the network and the clock drive it */
+  for (i = 0; i < sim->nentities; i++)
+    sim->params.protocol->init(sim, i);
+  return sim;
+}
+
+void sim_destroy(struct simulation *sim)
+{
+  int i;
+
+  for (i = 0; i < sim->nentities; i++) {
+    if (sim->backlog[i] != NULL)
+      backlog_destroy(sim->backlog[i]);
+    free(sim->sent[i].t);
+  }
+  resetevents(sim);
+  free(sim->evheap);
+  free(sim->state);
+  free(sim->msgs);
+  free(sim->sent);              /* the block of every per-entity array */
+  free(sim->queues);
+  evlog_close(sim->evlog);
+  trace_close(&sim->trace);
+  free(sim);
 }
 
 /********************** Student-callable ROUTINES ***********************/
 
 /* called by students routine to cancel a previously-started timer */
-void stoptimer(int AorB)
+void stoptimer(struct simulation *sim, int AorB)
 /* A or B is trying to stop timer */
 {
-  struct event *q;
-
-  if (TRACE>1)
-    printf("          STOP TIMER: stopping timer at %f\n",time);
-  /* for (q=evlist; q!=NULL && q->next!=NULL; q = q->next)  */
-  for (q=evlist; q!=NULL ; q = q->next) 
-    if ( (q->evtype==TIMER_INTERRUPT  && q->eventity==AorB) ) { 
-      /* remove this event */
-      if (q->next==NULL && q->prev==NULL)
-        evlist=NULL;         /* remove first and only event on list */
-      else if (q->next==NULL) /* end of list - there is one in front */
-        q->prev->next = NULL;
-      else if (q==evlist) { /* front of list - there must be event after */
-        q->next->prev=NULL;
-        evlist = q->next;
-      }
-      else {     /* middle of list */
-        q->next->prev = q->prev;
-        q->prev->next =  q->next;
-      }
-      free(q);
-      return;
-    }
-  printf("Warning: unable to cancel your timer. It wasn't running.\n");
+  if (sim->udp != NULL) {
+    udp_stoptimer(sim->udp);
+    return;
+  }
+  if (TRACING(sim, 2))
+    trace_printf(sim, "          STOP TIMER: stopping timer at %f\n",sim->time);
+  if (sim->timerev[AorB] == NULL) {
+    trace_printf(sim, "Warning: unable to cancel your timer. It wasn't running.\n");
+    return;
+  }
+  /* leave the event in the heap as a tombstone; the main loop discards */
+  /* it when it reaches the top, which saves rebalancing the heap now   */
+  sim->timerev[AorB]->evtype = TIMER_CANCELLED;
+  sim->timerev[AorB] = NULL;
+  if (sim->evlog != NULL)
+    evlog_put(sim->evlog, sim->time, EVLOG_TIMER_STOP, AorB, 0, 0, 0);
 }
 
 
-void starttimer(int AorB, double increment)
+void starttimer(struct simulation *sim, int AorB, double increment)
 /* A or B is trying to start timer */
 {
 
-  struct event *q;
   struct event *evptr;
 
-  if (TRACE>1)
-    printf("          START TIMER: starting timer at %f\n",time);
+  if (sim->udp != NULL) {
+    udp_starttimer(sim->udp, increment);
+    return;
+  }
+  if (TRACING(sim, 2))
+    trace_printf(sim, "          START TIMER: starting timer at %f\n",sim->time);
   /* be nice: check to see if timer is already started, if so, then  warn */
-  /* for (q=evlist; q!=NULL && q->next!=NULL; q = q->next)  */
-  for (q=evlist; q!=NULL ; q = q->next)  
-    if ( (q->evtype==TIMER_INTERRUPT  && q->eventity==AorB) ) { 
-      printf("Warning: attempt to start a timer that is already started\n");
-      return;
-    }
+  if (sim->timerev[AorB] != NULL) {
+    trace_printf(sim, "Warning: attempt to start a timer that is already started\n");
+    return;
+  }
  
   /* create future event for when timer goes off */
-  evptr = malloc(sizeof(struct event));
-  if (evptr == 0) {
-    printf("memory allocation for event failed.");
-    exit(EXIT_FAILURE);
-  }
-  evptr->evtime =  time + increment;
+  evptr = allocevent(sim);
+  evptr->evtime =  sim->time + increment;
   evptr->evtype =  TIMER_INTERRUPT;
    
  
   evptr->eventity = AorB;
-  insertevent(evptr);
+  insertevent(sim, evptr);
+  sim->timerev[AorB] = evptr;
+  if (sim->evlog != NULL)
+    evlog_put(sim->evlog, sim->time, EVLOG_TIMER_START, AorB, 0, 0, 0);
 } 
 
 
+/* send packet event p, sent at time p->evtime, over its channel and set */
+/* its arrival time.  returns -1 if the channel loses or drops it */
+static int scheduledelivery(struct simulation *sim, struct event *p)
+{
+  int side = entity_side(p->eventity), flow = entity_flow(p->eventity), lossy, outcome;
+  struct channel *c;
+
+  /* with a bottleneck every flow's packets to that side share the channel */
+  c = &sim->channels[sim->params.bottleneck ? side : p->eventity];
+  lossy = !(side == A && sim->params.corruptdirection == A) &&
+          !(side == B && sim->params.corruptdirection == B);
+  outcome = channel_send(sim, c, flow, p->evtime, pkt_size(&p->pkt), lossy,
+                         &p->evtime, &sim->sums[flow].busy[side]);
+  if (outcome == CHAN_SENT)
+    return 0;
+  sim->stats.nlost++;
+  if (outcome == CHAN_DROPPED)
+    sim->stats.ndropped++;
+  if (TRACING(sim, 1))
+    trace_printf(sim, outcome == CHAN_DROPPED ? "          TOLAYER3: packet dropped, the queue is full\n"
+                                              : "          TOLAYER3: packet lost in a bad spell\n");
+  return -1;
+}
+
+/* hold packet event p, numbered but without its arrival time yet, */
+/* for sim_schedule() */
+static void addpending(struct simulation *sim, struct event *p)
+{
+  struct event **grown;
+
+  if (sim->npending == sim->pendingcap) {
+    sim->pendingcap = sim->pendingcap ? 2 * sim->pendingcap : 64;
+    grown = realloc(sim->pending, sim->pendingcap * sizeof(struct event *));
+    if (grown == 0) {
+      printf("memory allocation for pending packets failed.");
+      exit(EXIT_FAILURE);
+    }
+    sim->pending = grown;
+  }
+  p->evseq = sim->evseqnext++;
+  sim->pending[sim->npending++] = p;
+}
+
 /************************** TOLAYER3 ***************/
-void tolayer3(int AorB, struct pkt packet)
+void tolayer3(struct simulation *sim, int AorB, const struct pkt *packet)
 /* A or B is sending to network  */
 {
   struct pkt *mypktptr;
-  struct event *evptr,*q;
-  float lastime, x;
-  int i;
+  struct event *evptr;
+  float x;
+  int logflags = 0, side = entity_side(AorB), flow = entity_flow(AorB), dropped = 0;
 
-  ntolayer3++;
+  sim->stats.ntolayer3++;
+  if (sim->udp != NULL) {       /* a real network is the channel */
+    udp_tolayer3(sim->udp, packet);
+    return;
+  }
 
-  /* simulate losses: */
-  if (jimsrand() < lossprob && (!(AorB == B && corruptdirection == A) && !(AorB == A && corruptdirection == B))) {
-    nlost++;
-    if (TRACE>0)    
-      printf("          TOLAYER3: packet being lost\n");
+  /* simulate losses (the channel model does, in bursts, for other models): */
+  if (sim->chan.loss == CHAN_LOSS_IID && jimsrand(sim, flow, RNG_LOSS) < sim->params.lossprob && (!(side == B && sim->params.corruptdirection == A) && !(side == A && sim->params.corruptdirection == B))) {
+    sim->stats.nlost++;
+    if (TRACING(sim, 1))    
+      trace_printf(sim, "          TOLAYER3: packet being lost\n");
+    if (sim->evlog != NULL)
+      evlog_put(sim->evlog, sim->time, EVLOG_TOLAYER3, AorB, EVLOG_LOST,
+                packet->seqnum, packet->acknum);
     return;
   }  
 
+  /* create future event for arrival of packet at the other side */
+  evptr = allocevent(sim);
+
   /* make a copy of the packet student just gave me since he/she may decide */
-  /* to do something with the packet after we return back to him/her */ 
-  mypktptr = malloc(sizeof(struct pkt));
-  if (mypktptr == 0) {
-    printf("memory allocation for event failed.");
-    exit(EXIT_FAILURE);
-  }
-  mypktptr->seqnum = packet.seqnum;
-  mypktptr->acknum = packet.acknum;
-  mypktptr->checksum = packet.checksum;
-  for (i=0; i<20; i++)
-    mypktptr->payload[i] = packet.payload[i];
-  if (TRACE>2)  {
-    printf("          TOLAYER3: seq: %d, ack %d, check: %d ", mypktptr->seqnum,
+  /* to do something with the packet after we return back to him/her.  it */
+  /* is the only copy: corruption is applied to it and the receiver gets */
+  /* a pointer to it */
+  mypktptr = &evptr->pkt;
+  memcpy(mypktptr, packet, pkt_size(packet));
+  if (TRACING(sim, 3))  {
+    trace_printf(sim, "          TOLAYER3: seq: %d, ack %d, check: %d ", mypktptr->seqnum,
            mypktptr->acknum,  mypktptr->checksum);
-    for (i=0; i<20; i++)
-      printf("%c",mypktptr->payload[i]);
-    printf("\n");
+    trace_printf(sim, "%.*s\n", mypktptr->length, mypktptr->payload);
   }
 
-  /* create future event for arrival of packet at the other side */
-  evptr = malloc(sizeof(struct event));
-  if (evptr == 0) {
-    printf("memory allocation for event failed.");
-    exit(EXIT_FAILURE);
-  }
   evptr->evtype =  FROM_LAYER3;   /* packet will pop out from layer3 */
-  evptr->eventity = (AorB+1) % 2; /* event occurs at other entity */
-  evptr->pktptr = mypktptr;       /* save ptr to my copy of packet */
-  /* finally, compute the arrival time of packet at the other end.
-     medium can not reorder, so make sure packet arrives between 1 and 10
-     time units after the latest arrival time of packets
-     currently in the medium on their way to the destination */
-  lastime = time;
-  /* for (q=evlist; q!=NULL && q->next!=NULL; q = q->next) */
-  for (q=evlist; q!=NULL ; q = q->next) 
-    if ( (q->evtype==FROM_LAYER3  && q->eventity==evptr->eventity) ) 
-      lastime = q->evtime;
-  evptr->evtime =  lastime + 1 + 9*jimsrand();
- 
-
+  evptr->eventity = entity_peer(AorB); /* event occurs at other entity */
+  evptr->evtime = sim->time;      /* for now, the time it was sent */
+  /* a partition cannot see what the other partitions are sending over */
+  /* a shared bottleneck yet, so its packets wait for sim_schedule()   */
+  if (sim->whole == NULL || !sim->params.bottleneck)
+    dropped = (scheduledelivery(sim, evptr) < 0);
 
   /* simulate corruption: */
-  if ((jimsrand() < corruptprob)  && (!(AorB == B && corruptdirection == A) && !(AorB == A && corruptdirection == B))) {
-    ncorrupt++;
-    if ( (x = jimsrand()) < .75)
+  if ((jimsrand(sim, flow, RNG_CORRUPT) < sim->params.corruptprob)  && (!(side == B && sim->params.corruptdirection == A) && !(side == A && sim->params.corruptdirection == B))) {
+    sim->stats.ncorrupt++;
+    logflags = EVLOG_CORRUPTED;
+    if ( (x = jimsrand(sim, flow, RNG_CORRUPT)) < .75 && mypktptr->length > 0)
       mypktptr->payload[0]='Z';   /* corrupt payload */
     else if (x < .875)
       mypktptr->seqnum = 999999;
     else
       mypktptr->acknum = 999999;
-    if (TRACE>0)    
-      printf("          TOLAYER3: packet being corrupted\n");
+    if (TRACING(sim, 1))    
+      trace_printf(sim, "          TOLAYER3: packet being corrupted\n");
   }  
 
-  if (TRACE>2)  
-    printf("          TOLAYER3: scheduling arrival on other side\n");
-  insertevent(evptr);
+  if (dropped) {
+    /* corrupted all the same, drawing what a partition that only */
+    /* learns of the loss later would have drawn */
+    freeevent(sim, evptr);
+    logflags |= EVLOG_LOST;
+  }
+  else {
+    if (TRACING(sim, 3))  
+      trace_printf(sim, "          TOLAYER3: scheduling arrival on other side\n");
+    if (sim->whole == NULL || !sim->params.bottleneck)
+      insertevent(sim, evptr);
+    else
+      addpending(sim, evptr);
+  }
+  if (sim->evlog != NULL)
+    evlog_put(sim->evlog, sim->time, EVLOG_TOLAYER3, AorB, logflags,
+              packet->seqnum, packet->acknum);
 } 
 
-void tolayer5(int AorB, char datasent[20])
+static void timeq_push(struct timeq *q, float t)
+{
+  float *grown;
+  int i, n;
+
+  if (q->count == q->capacity) {
+    n = q->capacity ? 2 * q->capacity : 64;
+    grown = malloc(n * sizeof(float));
+    if (grown == 0) {
+      printf("memory allocation for message times failed.");
+      exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < q->count; i++)      /* unwrap the ring */
+      grown[i] = q->t[(q->head + i) % q->capacity];
+    free(q->t);
+    q->t = grown;
+    q->capacity = n;
+    q->head = 0;
+  }
+  q->t[(q->head + q->count) % q->capacity] = t;
+  q->count++;
+}
+
+static float timeq_pop(struct timeq *q)
 {
-  int i;  
-  if (TRACE>2) {
-    printf("          TOLAYER5: data received by application at ");
-    if (AorB == A) 
-      printf("A: ");
+  float t = q->t[q->head];
+
+  q->head = (q->head + 1) % q->capacity;
+  q->count--;
+  return t;
+}
+
+void tolayer5(struct simulation *sim, int AorB, const char *datasent, int length)
+{
+  float latency;
+
+  if (sim->udp != NULL) {
+    udp_tolayer5(sim->udp, datasent, length);
+    return;
+  }
+  if (TRACING(sim, 3)) {
+    trace_printf(sim, "          TOLAYER5: data received by application at ");
+    if (entity_side(AorB) == A) 
+      trace_printf(sim, "A: ");
     else
-      printf("B: ");
-    for (i=0; i<20; i++)  
-      printf("%c",datasent[i]);
-    printf("\n");
+      trace_printf(sim, "B: ");
+    trace_printf(sim, "%.*s\n", length, datasent);
+  }
+  sim->stats.messages_delivered++;
+  sim->delivered[entity_flow(AorB)]++;
+  /* delivery is in order, so this is the oldest message the other side */
+  /* accepted and has not had delivered */
+  if (sim->sent[entity_peer(AorB)].count > 0) {
+    latency = sim->time - timeq_pop(&sim->sent[entity_peer(AorB)]);
+    hist_record(&sim->stats.latency, latency);
+    sim->sums[entity_flow(AorB)].latency += latency;
+  }
+  if (sim->evlog != NULL)
+    evlog_put(sim->evlog, sim->time, EVLOG_TOLAYER5, AorB, 0, 0, 0);
+}
+
+/* hand n messages to the output routine of entity AorB, returns how */
+/* many it accepted */
+static int tolayer4(struct simulation *sim, int AorB, const struct msg *msgs, int n)
+{
+  int i, accepted;
+
+  accepted = sim->params.protocol->output(sim, AorB, msgs, n);
+  for (i = 0; i < accepted; i++)
+    timeq_push(&sim->sent[AorB], sim->time);
+  return accepted;
+}
+
+void drainbacklog(struct simulation *sim, int AorB)
+{
+  struct backlog *b = sim->backlog[AorB];
+  int n, accepted;
+
+  if (sim->udp != NULL) {       /* read more of the stream being sent */
+    udp_drain(sim->udp);
+    return;
   }
-  messages_delivered++;
+  if (b == NULL)
+    return;
+  /* a run at a time, the ring may wrap */
+  while ((n = backlog_run(b)) > 0) {
+    accepted = tolayer4(sim, AorB, backlog_first(b), n);
+    backlog_pop(b, accepted, sim->time, &sim->sums[entity_flow(AorB)].queue_delay);
+    sim->stats.backlogged += accepted;
+    if (TRACING(sim, 3) && accepted > 0)
+      trace_printf(sim, "          BACKLOG: %d messages sent from the backlog of %c, %d still waiting\n",
+                   accepted, entity_side(AorB) == A ? 'A' : 'B', b->count);
+    if (accepted < n)
+      break;
+  }
+}
+
+/* the n messages of a layer 5 arrival at A or B.  with a backlog, those */
+/* the window has no room for wait, behind any that are waiting already */
+static void fromlayer5(struct simulation *sim, int AorB, int n)
+{
+  struct backlog *b = sim->backlog[AorB];
+  int i, accepted = 0;
+
+  if (b == NULL || b->count == 0)
+    accepted = tolayer4(sim, AorB, sim->msgs, n);
+  if (b == NULL) {
+    sim->stats.window_full += n - accepted;
+    return;
+  }
+  for (i = accepted; i < n; i++)
+    if (backlog_push(b, msg_at(sim->msgs, sim->msgstride, i), sim->time) < 0)
+      sim->stats.window_full++;
+  if (b->count > sim->stats.backlog_max)
+    sim->stats.backlog_max = b->count;
+}
+
+void sim_idle(struct simulation *sim, float t)
+{
+  struct event *evptr;
+
+  evptr = allocevent(sim);
+  evptr->evtime = t;
+  evptr->evtype = TIMER_CANCELLED;
+  evptr->eventity = A;
+  insertevent(sim, evptr);
 }
 
-int main(void)
+int sim_step(struct simulation *sim)
 {
   struct event *eventptr;
-  struct msg  msg2give;
-  struct pkt  pkt2give;
+  struct msg  *msg2give;
    
-  int i,j;
+  int i,j,n,flow;
   
-  init();
-  A_init();
-  B_init();
-   
-  while (1) {
-    eventptr = evlist;            /* get next event to simulate */
-    if (eventptr==NULL)
-      goto terminate;
-    evlist = evlist->next;        /* remove this event from event list */
-    if (evlist!=NULL)
-      evlist->prev=NULL;
-    if (TRACE>=2) {
-      printf("\nEVENT time: %f,",eventptr->evtime);
-      printf("  type: %d",eventptr->evtype);
-      if (eventptr->evtype==0)
-        printf(", timerinterrupt  ");
-      else if (eventptr->evtype==1)
-        printf(", fromlayer5 ");
-      else
-        printf(", fromlayer3 ");
-      printf(" entity: %d\n",eventptr->eventity);
-    }
-    time = eventptr->evtime;        /* update time to next event time */
-    if (eventptr->evtype == FROM_LAYER5 ) {
-      if (nsim < nsimmax) {
-        generate_next_arrival();   /* set up future arrival */
+  eventptr = popevent(sim);     /* get and remove next event to simulate */
+  if (eventptr==NULL)
+    return 0;
+  if (eventptr->evtype == TIMER_CANCELLED) {
+    freeevent(sim, eventptr);   /* timer was stopped, nothing to do */
+    return 1;
+  }
+  if (TRACING(sim, 2)) {
+    trace_printf(sim, "\nEVENT time: %f,",eventptr->evtime);
+    trace_printf(sim, "  type: %d",eventptr->evtype);
+    if (eventptr->evtype==0)
+      trace_printf(sim, ", timerinterrupt  ");
+    else if (eventptr->evtype==1)
+      trace_printf(sim, ", fromlayer5 ");
+    else
+      trace_printf(sim, ", fromlayer3 ");
+    trace_printf(sim, " entity: %d\n",eventptr->eventity);
+  }
+  sim->time = eventptr->evtime;        /* update time to next event time */
+  if (eventptr->evtype == FROM_LAYER5 ) {
+    flow = entity_flow(eventptr->eventity);
+    if (sim->generated[flow] < flowquota(&sim->params, flow)) {
+      generate_next_arrival(sim, flow);   /* set up future arrival */
+      /* a burst of messages, the last one cut short at the flow's quota */
+      n = flowquota(&sim->params, flow) - sim->generated[flow];
+      if (n > sim->params.burst)
+        n = sim->params.burst;
+      for (i=0; i<n; i++) {
         /* fill in msg to give with string of same letter */    
-        j = nsim % 26; 
-        for (i=0; i<20; i++)  
-          msg2give.data[i] = 97 + j;
-        if (TRACE>2) {
-          printf("          MAINLOOP: data given to student: ");
-          for (i=0; i<20; i++) 
-            printf("%c", msg2give.data[i]);
-          printf("\n");
-        }
-        nsim++;
-        if (eventptr->eventity == A) 
-          A_output(msg2give);  
-        else
-          B_output(msg2give);  
+        msg2give = msg_at(sim->msgs, sim->msgstride, i);
+        j = sim->generated[flow] % 26; 
+        msg2give->length = sim->params.payload;
+        memset(msg2give->data, 97 + j, msg2give->length);
+        if (TRACING(sim, 3))
+          trace_printf(sim, "          MAINLOOP: data given to student: %.*s\n",
+                       msg2give->length, msg2give->data);
+        if (sim->evlog != NULL)
+          evlog_put(sim->evlog, sim->time, EVLOG_FROM_LAYER5, eventptr->eventity, 0,
+                    sim->generated[flow], 0);
+        sim->generated[flow]++;
+        sim->nsim++;
       }
-      else if (TRACE > 2)
-          printf("          FROM_LAYER5: no more messages to send: \n");
+      fromlayer5(sim, eventptr->eventity, n);
+    }
+    else if (TRACING(sim, 3))
+        trace_printf(sim, "          FROM_LAYER5: no more messages to send: \n");
+  }
+  else if (eventptr->evtype ==  FROM_LAYER3) {
+    if (sim->evlog != NULL)
+      evlog_put(sim->evlog, sim->time, EVLOG_FROM_LAYER3, eventptr->eventity, 0,
+                eventptr->pkt.seqnum, eventptr->pkt.acknum);
+    /* deliver packet by calling appropriate entity */
+    sim->params.protocol->input(sim, eventptr->eventity, &eventptr->pkt);
+  }
+  else if (eventptr->evtype ==  TIMER_INTERRUPT) {
+    sim->timerev[eventptr->eventity] = NULL;  /* timer is off once it fires */
+    if (sim->evlog != NULL)
+      evlog_put(sim->evlog, sim->time, EVLOG_TIMER_FIRE, eventptr->eventity, 0, 0, 0);
+    sim->params.protocol->timerinterrupt(sim, eventptr->eventity);
+  }
+  else  {
+    trace_printf(sim, "INTERNAL PANIC: unknown event type \n");
+  }
+  freeevent(sim, eventptr);
+  return 1;
+}
+
+/* add up the flows' sums into stats, flow by flow */
+static void addsums(struct simulation *sim)
+{
+  struct sim_stats *s = &sim->stats;
+  int i;
+
+  s->busy[A] = s->busy[B] = s->queue_delay = s->latency.sum = 0.0;
+  for (i = 0; i < sim->params.flows; i++) {
+    s->busy[A] += sim->sums[i].busy[A];
+    s->busy[B] += sim->sums[i].busy[B];
+    s->queue_delay += sim->sums[i].queue_delay;
+    s->latency.sum += sim->sums[i].latency;
+  }
+}
+
+void sim_run(struct simulation *sim)
+{
+  if (sim->params.partitions > 1 && sim->params.flows > 1)
+    pdes_run(sim);
+  else {
+    /* checkpoints are written between events, before the first one due */
+    /* at or after the checkpoint time */
+    while (sim->evcount > 0) {
+      if (sim->cknext > 0 && sim->evheap[0]->evtime >= sim->cknext) {
+        if (sim_checkpoint(sim, sim->params.checkpoint) == 0 && TRACING(sim, 1))
+          trace_printf(sim, "          CHECKPOINT: written to %s at time %f\n",
+                       sim->params.checkpoint, sim->time);
+        while (sim->cknext > 0 && sim->cknext <= sim->evheap[0]->evtime)
+          sim->cknext = nextcheckpoint(&sim->params, sim->cknext);
+      }
+      sim_step(sim);
+    }
+  }
+  addsums(sim);
+  trace_flush(&sim->trace);
+}
+
+/********************* PARTITIONS *******/
+
+/* the partition of n that simulates flow */
+#define partof(sim, n, flow) ((int)((long)(flow) * (n) / (sim)->params.flows))
+
+struct simulation **sim_split(struct simulation *sim, int n)
+{
+  struct simulation **parts, *part;
+  struct event *ev, *copy;
+  int i, k;
+
+  parts = malloc(n * sizeof(struct simulation *));
+  if (parts == 0) {
+    printf("memory allocation for partitions failed.");
+    exit(EXIT_FAILURE);
+  }
+  for (k = 0; k < n; k++) {
+    part = malloc(sizeof(struct simulation));
+    if (part == 0) {
+      printf("memory allocation for partitions failed.");
+      exit(EXIT_FAILURE);
+    }
+    *part = *sim;               /* shares params, state and the per-flow arrays */
+    memset(&part->stats, 0, sizeof(part->stats));
+    part->nsim = 0;
+    part->msgs = malloc(sim->params.burst * sim->msgstride);
+    if (part->msgs == 0) {
+      printf("memory allocation for messages failed.");
+      exit(EXIT_FAILURE);
+    }
+    part->evheap = NULL;
+    part->evcount = part->evcapacity = 0;
+    part->evslabs = NULL;
+    part->evfree = NULL;
+    part->trace.buf = NULL;     /* its own buffer, into the same file */
+    part->trace.len = 0;
+    part->trace.owned = 0;
+    part->whole = sim;
+    part->pending = NULL;
+    part->npending = part->pendingcap = 0;
+    parts[k] = part;
+  }
+
+  /* hand every event to the partition of its flow, keeping its place */
+  for (i = 0; i < sim->evcount; i++) {
+    ev = sim->evheap[i];
+    part = parts[partof(sim, n, entity_flow(ev->eventity))];
+    copy = allocevent(part);
+    copy->evtime = ev->evtime;
+    copy->evtype = ev->evtype;
+    copy->eventity = ev->eventity;
+    copy->evseq = ev->evseq;
+    if (ev->evtype == FROM_LAYER3)
+      memcpy(&copy->pkt, &ev->pkt, pkt_size(&ev->pkt));
+    if (sim->timerev[ev->eventity] == ev)
+      sim->timerev[ev->eventity] = copy;
+    pushevent(part, copy);
+    freeevent(sim, ev);
+  }
+  sim->evcount = 0;
+  return parts;
+}
+
+/* add the counters of from to s */
+static void addstats(struct sim_stats *s, const struct sim_stats *from)
+{
+  s->total_ACKs_received += from->total_ACKs_received;
+  s->packets_resent += from->packets_resent;
+  s->new_ACKs += from->new_ACKs;
+  s->packets_received += from->packets_received;
+  s->fast_retransmits += from->fast_retransmits;
+  s->window_full += from->window_full;
+  s->backlogged += from->backlogged;
+  if (from->backlog_max > s->backlog_max)
+    s->backlog_max = from->backlog_max;
+  s->messages_delivered += from->messages_delivered;
+  s->ntolayer3 += from->ntolayer3;
+  s->nlost += from->nlost;
+  s->ndropped += from->ndropped;
+  s->ncorrupt += from->ncorrupt;
+  hist_add(&s->latency, &from->latency);   /* the sums come from addsums() */
+}
+
+void sim_join(struct simulation *sim, struct simulation **parts, int n)
+{
+  struct evslab *slab;
+  struct simulation *part;
+  int k;
+
+  for (k = 0; k < n; k++) {
+    part = parts[k];
+    addstats(&sim->stats, &part->stats);
+    sim->nsim += part->nsim;
+    if (part->time > sim->time)
+      sim->time = part->time;
+    while (part->evslabs != NULL) {
+      slab = part->evslabs;
+      part->evslabs = slab->next;
+      free(slab);
+    }
+    trace_flush(&part->trace);
+    free(part->trace.buf);
+    free(part->evheap);
+    free(part->msgs);
+    free(part->pending);
+    free(part);
+  }
+  free(parts);
+}
+
+void sim_schedule(struct simulation **parts, int n)
+{
+  int next[PDES_MAXPARTS];
+  struct event *ev;
+  int k, best;
+
+  /* each partition's packets are in the order it sent them, so      */
+  /* merging them on (time sent, flow, evseq) restores the order of a */
+  /* single event loop, which the channel's FIFO depends on           */
+  for (k = 0; k < n; k++)
+    next[k] = 0;
+  for (;;) {
+    best = -1;
+    for (k = 0; k < n; k++)
+      if (next[k] < parts[k]->npending &&
+          (best < 0 || evbefore(parts[k]->pending[next[k]], parts[best]->pending[next[best]])))
+        best = k;
+    if (best < 0)
+      break;
+    ev = parts[best]->pending[next[best]++];
+    if (scheduledelivery(parts[best], ev) < 0)
+      freeevent(parts[best], ev);
+    else
+      pushevent(parts[best], ev);
+  }
+  for (k = 0; k < n; k++)
+    parts[k]->npending = 0;
+}
+
+float sim_nexttime(const struct simulation *sim)
+{
+  return sim->evcount > 0 ? sim->evheap[0]->evtime : HUGE_VALF;
+}
+
+float sim_lookahead(const struct simulation *sim, float t)
+{
+  float a, b;
+
+  if (!sim->params.bottleneck)
+    return HUGE_VALF;           /* no flow's packets reach another flow */
+  a = channel_lookahead(&sim->chan, &sim->channels[A], t);
+  b = channel_lookahead(&sim->chan, &sim->channels[B], t);
+  return a < b ? a : b;
+}
+
+void sim_stepfirst(struct simulation **parts, int n)
+{
+  int k, best = -1;
+
+  for (k = 0; k < n; k++)
+    if (parts[k]->evcount > 0 &&
+        (best < 0 || evbefore(parts[k]->evheap[0], parts[best]->evheap[0])))
+      best = k;
+  if (best >= 0)
+    sim_step(parts[best]);
+}
+
+void sim_rununtil(struct simulation *sim, float end)
+{
+  while (sim->evcount > 0 && sim->evheap[0]->evtime < end)
+    sim_step(sim);
+}
+
+/********************* CHECKPOINTS *******/
+
+/* an event as stored in a checkpoint, followed by its packet if it has one */
+struct ckevent {
+  float evtime;
+  int evtype;
+  int eventity;
+  int timer;              /* the pending timer event of eventity */
+  unsigned long evseq;
+};
+
+int sim_checkpoint(const struct simulation *sim, const char *file)
+{
+  const struct channel *c;
+  const struct backlog *b;
+  const struct msg *m;
+  const struct timeq *q;
+  const struct event *ev;
+  struct ckevent ce;
+  struct ckwriter w;
+  size_t size;
+  int i, k;
+
+  if (ckwrite_open(&w, file, &sim->params) < 0)
+    return -1;
+  ckwrite_put(&w, &sim->time, sizeof(sim->time));
+  ckwrite_put(&w, &sim->nsim, sizeof(sim->nsim));
+  ckwrite_put(&w, &sim->evseqnext, sizeof(sim->evseqnext));
+  ckwrite_align(&w);
+  ckwrite_put(&w, &sim->stats, sizeof(sim->stats));
+  ckwrite_put(&w, sim->streams, sim->params.flows * NUM_RNG * sizeof(struct rng));
+  ckwrite_put(&w, sim->sums, sim->params.flows * sizeof(struct flowsums));
+  ckwrite_align(&w);
+  for (i = 0; i < sim->nentities; i++) {   /* channels, queues oldest first */
+    c = &sim->channels[i];
+    ckwrite_put(&w, &c->last, sizeof(c->last));
+    ckwrite_put(&w, &c->bad, sizeof(c->bad));
+    ckwrite_put(&w, &c->qcount, sizeof(c->qcount));
+    for (k = 0; k < c->qcount; k++)
+      ckwrite_put(&w, &c->queue[(c->qhead + k) % sim->chan.queuelimit], sizeof(float));
+    ckwrite_align(&w);
+  }
+  ckwrite_put(&w, sim->delivered, sim->params.flows * sizeof(int));
+  ckwrite_align(&w);
+  ckwrite_put(&w, sim->generated, sim->params.flows * sizeof(int));
+  ckwrite_align(&w);
+
+  size = sim->params.protocol->statesize(&sim->params);    /* protocol state */
+  ckwrite_put(&w, &size, sizeof(size));
+  ckwrite_put(&w, sim->state, size);
+  ckwrite_align(&w);
+  for (i = 0; i < sim->nentities; i++) {   /* backlogs, oldest message first */
+    b = sim->backlog[i];
+    k = (b != NULL) ? b->count : 0;
+    ckwrite_put(&w, &k, sizeof(k));
+    ckwrite_align(&w);
+    for (k = 0; b != NULL && k < b->count; k++) {
+      ckwrite_put(&w, &b->since[(b->head + k) % b->capacity], sizeof(float));
+      m = msg_at(b->msgs, b->stride, (b->head + k) % b->capacity);
+      ckwrite_put(&w, m, offsetof(struct msg, data) + m->length);
+      ckwrite_align(&w);
     }
-    else if (eventptr->evtype ==  FROM_LAYER3) {
-      pkt2give.seqnum = eventptr->pktptr->seqnum;
-      pkt2give.acknum = eventptr->pktptr->acknum;
-      pkt2give.checksum = eventptr->pktptr->checksum;
-      for (i=0; i<20; i++)  
-        pkt2give.payload[i] = eventptr->pktptr->payload[i];
-	    if (eventptr->eventity ==A)      /* deliver packet by calling */
-        A_input(pkt2give);            /* appropriate entity */
-      else
-        B_input(pkt2give);
-	    free(eventptr->pktptr);          /* free the memory for packet */
+  }
+  for (i = 0; i < sim->nentities; i++) {   /* when the undelivered messages were accepted */
+    q = &sim->sent[i];
+    ckwrite_put(&w, &q->count, sizeof(q->count));
+    for (k = 0; k < q->count; k++)
+      ckwrite_put(&w, &q->t[(q->head + k) % q->capacity], sizeof(float));
+    ckwrite_align(&w);
+  }
+
+  /* the events in heap order, which is still a heap when read back */
+  ckwrite_put(&w, &sim->evcount, sizeof(sim->evcount));
+  ckwrite_align(&w);
+  for (i = 0; i < sim->evcount; i++) {
+    ev = sim->evheap[i];
+    memset(&ce, 0, sizeof(ce));
+    ce.evtime = ev->evtime;
+    ce.evtype = ev->evtype;
+    ce.eventity = ev->eventity;
+    ce.timer = (sim->timerev[ev->eventity] == ev);
+    ce.evseq = ev->evseq;
+    ckwrite_put(&w, &ce, sizeof(ce));
+    if (ev->evtype == FROM_LAYER3)
+      ckwrite_put(&w, &ev->pkt, pkt_size(&ev->pkt));
+    ckwrite_align(&w);
+  }
+  return ckwrite_close(&w, file);
+}
+
+/* the parameters the saved state depends on */
+static const struct {
+  const char *name;
+  size_t offset;
+} fixedparams[] = {
+  { "window",        offsetof(struct sim_params, windowsize) },
+  { "seqspace",      offsetof(struct sim_params, seqspace) },
+  { "payload",       offsetof(struct sim_params, payload) },
+  { "burst",         offsetof(struct sim_params, burst) },
+  { "backlog",       offsetof(struct sim_params, backlog) },
+  { "bidirectional", offsetof(struct sim_params, bidirectional) },
+  { "flows",         offsetof(struct sim_params, flows) },
+  { "bottleneck",    offsetof(struct sim_params, bottleneck) },
+  { "queue-limit",   offsetof(struct sim_params, queuelimit) },
+  { "ack-mode",      offsetof(struct sim_params, ackmode) },
+  { "checksum",      offsetof(struct sim_params, checksum) },
+  { "adaptive-rto",  offsetof(struct sim_params, adaptiverto) },
+  { "congestion",    offsetof(struct sim_params, congestion) },
+  { "rng",           offsetof(struct sim_params, rngkind) },
+};
+
+/* read the sections sim_checkpoint() wrote; -1 if they are cut short */
+/* or make no sense */
+static int loadsim(struct simulation *sim, struct ckreader *r, int sameseed)
+{
+  struct channel *c;
+  struct ckevent ce;
+  struct event *ev;
+  struct msg m;
+  size_t size;
+  float t;
+  int i, k, n;
+
+  if (ckread_copy(r, &sim->time, sizeof(sim->time)) < 0 ||
+      ckread_copy(r, &sim->nsim, sizeof(sim->nsim)) < 0 ||
+      ckread_copy(r, &sim->evseqnext, sizeof(sim->evseqnext)) < 0)
+    return -1;
+  ckread_align(r);
+  if (ckread_copy(r, &sim->stats, sizeof(sim->stats)) < 0 ||
+      ckread_copy(r, sim->streams, sim->params.flows * NUM_RNG * sizeof(struct rng)) < 0 ||
+      ckread_copy(r, sim->sums, sim->params.flows * sizeof(struct flowsums)) < 0)
+    return -1;
+  if (!sameseed)               /* start the streams afresh from the new seed */
+    rng_seed_streams(sim->streams, sim->params.flows * NUM_RNG, sim->params.rngkind,
+                     sim->params.seed);
+  ckread_align(r);
+  for (i = 0; i < sim->nentities; i++) {
+    c = &sim->channels[i];
+    if (ckread_copy(r, &c->last, sizeof(c->last)) < 0 ||
+        ckread_copy(r, &c->bad, sizeof(c->bad)) < 0 ||
+        ckread_copy(r, &n, sizeof(n)) < 0 || n < 0 || n > sim->chan.queuelimit)
+      return -1;
+    for (k = 0; k < n; k++)
+      if (ckread_copy(r, &c->queue[c->qcount++], sizeof(float)) < 0)
+        return -1;
+    ckread_align(r);
+  }
+  if (ckread_copy(r, sim->delivered, sim->params.flows * sizeof(int)) < 0)
+    return -1;
+  ckread_align(r);
+  if (ckread_copy(r, sim->generated, sim->params.flows * sizeof(int)) < 0)
+    return -1;
+  ckread_align(r);
+
+  if (ckread_copy(r, &size, sizeof(size)) < 0 ||
+      size != sim->params.protocol->statesize(&sim->params) ||
+      ckread_copy(r, sim->state, size) < 0)
+    return -1;
+  sim->params.protocol->relink(sim);
+  ckread_align(r);
+  for (i = 0; i < sim->nentities; i++) {
+    if (ckread_copy(r, &n, sizeof(n)) < 0 ||
+        (n > 0 && (sim->backlog[i] == NULL || n > sim->backlog[i]->capacity)))
+      return -1;
+    ckread_align(r);
+    for (k = 0; k < n; k++) {
+      if (ckread_copy(r, &t, sizeof(t)) < 0 ||
+          ckread_copy(r, &m, offsetof(struct msg, data)) < 0 ||
+          m.length < 0 || m.length > sim->params.payload ||
+          ckread_copy(r, m.data, m.length) < 0)
+        return -1;
+      backlog_push(sim->backlog[i], &m, t);
+      ckread_align(r);
     }
-    else if (eventptr->evtype ==  TIMER_INTERRUPT) {
-      if (eventptr->eventity == A) 
-        A_timerinterrupt();
-      else
-        B_timerinterrupt();
+  }
+  for (i = 0; i < sim->nentities; i++) {
+    if (ckread_copy(r, &n, sizeof(n)) < 0)
+      return -1;
+    for (k = 0; k < n; k++) {
+      if (ckread_copy(r, &t, sizeof(t)) < 0)
+        return -1;
+      timeq_push(&sim->sent[i], t);
     }
-    else  {
-      printf("INTERNAL PANIC: unknown event type \n");
+    ckread_align(r);
+  }
+
+  if (ckread_copy(r, &n, sizeof(n)) < 0 || n < 0)
+    return -1;
+  ckread_align(r);
+  sim->evcapacity = (n > 64) ? n : 64;
+  sim->evheap = malloc(sim->evcapacity * sizeof(struct event *));
+  if (sim->evheap == 0) {
+    printf("memory allocation for event list failed.");
+    exit(EXIT_FAILURE);
+  }
+  for (i = 0; i < n; i++) {
+    if (ckread_copy(r, &ce, sizeof(ce)) < 0 || ce.evtype < TIMER_INTERRUPT ||
+        ce.evtype > TIMER_CANCELLED || ce.eventity < 0 || ce.eventity >= sim->nentities)
+      return -1;
+    ev = allocevent(sim);
+    sim->evheap[sim->evcount++] = ev;
+    ev->evtime = ce.evtime;
+    ev->evtype = ce.evtype;
+    ev->eventity = ce.eventity;
+    ev->evseq = ce.evseq;
+    if (ce.timer)
+      sim->timerev[ce.eventity] = ev;
+    if (ce.evtype == FROM_LAYER3 &&
+        (ckread_copy(r, &ev->pkt, offsetof(struct pkt, payload)) < 0 ||
+         ev->pkt.length < 0 || ev->pkt.length > pkt_room(&sim->params) ||
+         ckread_copy(r, ev->pkt.payload, ev->pkt.length) < 0))
+      return -1;
+    ckread_align(r);
+  }
+  return 0;
+}
+
+struct simulation *sim_restore(const struct checkpoint *ck, const struct sim_params *params)
+{
+  struct simulation *sim;
+  struct ckreader r;
+  int i;
+
+  if ((sim = newsim(params)) == NULL)
+    return NULL;
+  if (sim->params.protocol != ck->params.protocol) {
+    fprintf(stderr, "restore: the checkpoint is of protocol %s\n", ck->params.protocol->name);
+    sim_destroy(sim);
+    return NULL;
+  }
+  for (i = 0; i < (int)(sizeof(fixedparams) / sizeof(fixedparams[0])); i++)
+    if (*(const int *)((const char *)&sim->params + fixedparams[i].offset) !=
+        *(const int *)((const char *)&ck->params + fixedparams[i].offset)) {
+      fprintf(stderr, "restore: %s cannot change from the checkpoint's %d\n", fixedparams[i].name,
+              *(const int *)((const char *)&ck->params + fixedparams[i].offset));
+      sim_destroy(sim);
+      return NULL;
     }
-    free(eventptr);
+
+  ckread_begin(&r, ck);
+  if (loadsim(sim, &r, sim->params.seed == ck->params.seed) < 0) {
+    fprintf(stderr, "restore: the checkpoint is truncated or damaged\n");
+    sim_destroy(sim);
+    return NULL;
   }
+  sim->cknext = nextcheckpoint(&sim->params, sim->time);
+  return sim;
+}
 
- terminate:
-  printf(" Simulator terminated at time %f\n after attempting to send %d msgs from layer5\n",time,nsim);
-  printf("number of messages dropped due to full window:  %d \n", window_full);
-  printf("number of valid (not corrupt or duplicate) acknowledgements received at A:  %d \n", new_ACKs);
+void sim_report(const struct simulation *sim)
+{
+  int i, lo, hi;
+
+  printf(" Simulator terminated at time %f\n after attempting to send %d msgs from layer5\n",sim->time,sim->nsim);
+  printf("number of messages dropped due to full window:  %d \n", sim->stats.window_full);
+  printf("number of valid (not corrupt or duplicate) acknowledgements received at A:  %d \n", sim->stats.new_ACKs);
   printf("(note: a single acknowledgement may have acknowledged more than one packet - if cumulative acknowledgements are used)\n");
-  printf("number of packet resends by A:  %d \n", packets_resent);
-  printf("number of correct packets received at B:  %d \n", packets_received);
-  printf("number of messages delivered to application:  %d \n", messages_delivered);
+  printf("number of packet resends by A:  %d \n", sim->stats.packets_resent);
+  if (sim->params.congestion != CC_NONE)
+    printf("number of fast retransmits by A:  %d \n", sim->stats.fast_retransmits);
+  printf("number of correct packets received at B:  %d \n", sim->stats.packets_received);
+  printf("number of messages delivered to application:  %d \n", sim->stats.messages_delivered);
+  if (sim->params.backlog > 0) {
+    printf("number of messages sent after waiting in the backlog:  %d \n", sim->stats.backlogged);
+    printf("mean time they waited:  %f \n",
+           sim->stats.backlogged ? sim->stats.queue_delay / sim->stats.backlogged : 0.0);
+    printf("most messages waiting in the backlog at once:  %d \n", sim->stats.backlog_max);
+  }
+  if (sim->params.queuelimit > 0)
+    printf("number of packets dropped at a full channel queue:  %d \n", sim->stats.ndropped);
+  printf("end-to-end latency of delivered messages:  mean %f, p50 %f, p99 %f, p99.9 %f, max %f \n",
+         hist_mean(&sim->stats.latency), hist_percentile(&sim->stats.latency, 0.5),
+         hist_percentile(&sim->stats.latency, 0.99), hist_percentile(&sim->stats.latency, 0.999),
+         sim->stats.latency.max);
+  printf("goodput (messages delivered per time unit):  %f \n", sim_goodput(sim));
+  printf("channel utilisation:  A->B %f, B->A %f \n",
+         sim_utilisation(sim, B), sim_utilisation(sim, A));
+  printf("packet resends per message delivered:  %f \n", sim_resentpermsg(sim));
+  if (sim->params.flows > 1) {
+    lo = hi = sim->delivered[0];
+    for (i = 1; i < sim->params.flows; i++) {
+      if (sim->delivered[i] < lo)
+        lo = sim->delivered[i];
+      if (sim->delivered[i] > hi)
+        hi = sim->delivered[i];
+    }
+    printf("flows:  %d%s, messages delivered per flow: min %d, mean %f, max %d \n",
+           sim->params.flows, sim->params.bottleneck ? " sharing one bottleneck" : "", lo,
+           (double)sim->stats.messages_delivered / sim->params.flows, hi);
+    printf("Jain's fairness index of the flows:  %f \n", sim_fairness(sim));
+  }
+}
+
+double sim_goodput(const struct simulation *sim)
+{
+  return sim->time > 0 ? sim->stats.messages_delivered / sim->time : 0.0;
+}
+
+double sim_utilisation(const struct simulation *sim, int AorB)
+{
+  int channels = sim->params.bottleneck ? 1 : sim->params.flows;
+
+  return sim->time > 0 ? sim->stats.busy[AorB] / (sim->time * channels) : 0.0;
+}
+
+double sim_fairness(const struct simulation *sim)
+{
+  double sum = 0.0, sumsq = 0.0;
+  int i;
+
+  for (i = 0; i < sim->params.flows; i++) {
+    sum += sim->delivered[i];
+    sumsq += (double)sim->delivered[i] * sim->delivered[i];
+  }
+  return sumsq > 0 ? sum * sum / (sim->params.flows * sumsq) : 1.0;
+}
+
+double sim_resentpermsg(const struct simulation *sim)
+{
+  return sim->stats.messages_delivered > 0 ?
+         (double)sim->stats.packets_resent / sim->stats.messages_delivered : 0.0;
+}
+
+int sim_report_json(const struct simulation *sim, const char *file)
+{
+  const struct sim_stats *s = &sim->stats;
+  FILE *fp = stdout;
+  int i;
+
+  if (strcmp(file, "-") != 0 && (fp = fopen(file, "w")) == NULL) {
+    fprintf(stderr, "cannot create %s\n", file);
+    return -1;
+  }
+  fprintf(fp, "{\"protocol\": \"%s\", \"seed\": %lu, \"messages\": %d, \"sim_time\": %.6g,\n",
+          sim->params.protocol->name, sim->params.seed, sim->nsim, sim->time);
+  fprintf(fp, " \"counters\": {\"window_full\": %d, \"total_ACKs_received\": %d, \"new_ACKs\": %d, "
+          "\"packets_resent\": %d, \"fast_retransmits\": %d, \"packets_received\": %d, "
+          "\"messages_delivered\": %d, \"backlogged\": %d, \"backlog_max\": %d, "
+          "\"packets_to_layer3\": %d, \"packets_lost\": %d, \"packets_dropped\": %d, "
+          "\"packets_corrupted\": %d},\n",
+          s->window_full, s->total_ACKs_received, s->new_ACKs, s->packets_resent,
+          s->fast_retransmits, s->packets_received, s->messages_delivered, s->backlogged,
+          s->backlog_max, s->ntolayer3, s->nlost, s->ndropped, s->ncorrupt);
+  fprintf(fp, " \"goodput\": %.6g, \"resent_per_message\": %.6g, "
+          "\"queue_delay\": %.6g,\n \"utilisation\": {\"AtoB\": %.6g, \"BtoA\": %.6g},\n",
+          sim_goodput(sim), sim_resentpermsg(sim),
+          s->backlogged ? s->queue_delay / s->backlogged : 0.0,
+          sim_utilisation(sim, B), sim_utilisation(sim, A));
+  fprintf(fp, " \"flows\": %d, \"bottleneck\": %d, \"fairness\": %.6g, \"flow_delivered\": [",
+          sim->params.flows, sim->params.bottleneck, sim_fairness(sim));
+  for (i = 0; i < sim->params.flows; i++)
+    fprintf(fp, "%s%d", i ? ", " : "", sim->delivered[i]);
+  fprintf(fp, "],\n \"latency\": ");
+  hist_json(&s->latency, fp);
+  fprintf(fp, "}\n");
+  if (fp != stdout)
+    fclose(fp);
+  else
+    fflush(fp);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  struct sim_params params;
+  struct simulation *sim;
+  struct checkpoint *ck;
+  int nset;
+
+  if (argc > 1 && strcmp(argv[1], "sweep") == 0)
+    return sweep_main(argc - 1, argv + 1);
+  if (argc > 1 && strcmp(argv[1], "bench") == 0)
+    return bench_main(argc - 1, argv + 1);
+  if (argc > 1 && strcmp(argv[1], "udp") == 0)
+    return udp_main(argc - 1, argv + 1);
+
+  params_default(&params);
+  nset = params_parse_args(&params, argc, argv);
+  if (nset == -2) {
+    params_usage(argv[0]);
+    return EXIT_SUCCESS;
+  }
+  if (nset < 0)
+    return EXIT_FAILURE;
+
+  printf("-----  Stop and Wait Network Simulator Version 1.1 -------- \n\n");
+  if (nset == 0)             /* nothing given on the command line, ask for it */
+    params_prompt(&params);
+
+  if (params.restore[0] != '\0') {
+    /* the flags apply on top of the checkpoint's parameters */
+    if ((ck = checkpoint_open(params.restore)) == NULL)
+      return EXIT_FAILURE;
+    params = ck->params;
+    params_parse_args(&params, argc, argv);
+    sim = sim_restore(ck, &params);
+    checkpoint_close(ck);
+  }
+  else
+    sim = sim_create(&params);
+  if (sim == NULL)
+    return EXIT_FAILURE;
+  sim_run(sim);
+  sim_report(sim);
+  if (params.statsjson[0] != '\0' && sim_report_json(sim, params.statsjson) < 0) {
+    sim_destroy(sim);
+    return EXIT_FAILURE;
+  }
+  sim_destroy(sim);
   return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
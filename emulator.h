@@ -1,40 +1,285 @@
-extern int TRACE;
+#ifndef EMULATOR_H
+#define EMULATOR_H
 
-/* statistics updated by GBN */
-extern int total_ACKs_received;
-extern int packets_resent;       /* count of the number of packets resent  */
-extern int new_ACKs;      /* count of the number of acks correctly received */
-extern int packets_received;  /* count of the packets received by receiver */
-extern int window_full; /* count of the number of messages dropped due to full window */
+#include <stddef.h>
+#include "params.h"
+#include "channel.h"
+#include "rng.h"
+#include "trace.h"
+#include "hist.h"
 
 #define   A    0
 #define   B    1
 
+/* with --flows N there are N pairs of entities: flow f's sides A and B */
+/* are entities 2f and 2f + 1, so flow 0's are A and B themselves */
+#define MAX_FLOWS  32768
+#define entity_of(flow, side)  (2 * (flow) + (side))
+#define entity_flow(e)         ((e) >> 1)
+#define entity_side(e)         ((e) & 1)     /* A or B */
+#define entity_peer(e)         ((e) ^ 1)     /* the other side of its flow */
+
+/* largest message and packet payload in bytes.  the "payload" parameter */
+/* picks the size actually used, up to this, and the emulator's and the  */
+/* protocols' buffers only take the room that size needs (see msg_at()) */
+#ifndef PAYLOAD_MAX
+#define PAYLOAD_MAX 1500
+#endif
+
 /* a "msg" is the data unit passed from layer 5 (teachers code) to layer  */
 /* 4 (students' code).  It contains the data (characters) to be delivered */
 /* to layer 5 via the students transport level protocol entities.         */
 struct msg {
-  char data[20];
+  int length;                 /* bytes used of data */
+  char data[PAYLOAD_MAX];
 };
 
 /* a packet is the data unit passed from layer 4 (students code) to layer */
 /* 3 (teachers code).  Note the pre-defined packet structure, which all   */
-/* students must follow. */
+/* students must follow.  Only the first length bytes of the payload are */
+/* carried, checksummed and delivered. */
 struct pkt {
   int seqnum;
   int acknum;
   int checksum;
-  char payload[20];
+  int length;                 /* bytes used of payload */
+  int flags;                  /* PKT_DATA, PKT_ACK */
+  char payload[PAYLOAD_MAX];
+};
+
+/* what a packet carries */
+#define PKT_DATA  1           /* seqnum and the payload are data */
+#define PKT_ACK   2           /* acknum acknowledges data of the other direction */
+
+/* bytes of packet p in use, header included; copy no more than this */
+#define pkt_size(p) (offsetof(struct pkt, payload) + (p)->length)
+
+/* PAYLOAD_MAX only bounds the payload: arrays of messages and packets */
+/* are not C arrays but slots stride bytes apart, as long as the run's */
+/* payloads need (see msg_stride() and pkt_stride() in protocol.h), so */
+/* a run of 20-byte messages does not reserve 1500 bytes for each one. */
+/* element i of such an array */
+#define msg_at(msgs, stride, i)  ((struct msg *)((char *)(msgs) + (size_t)(i) * (stride)))
+#define pkt_at(pkts, stride, i)  ((struct pkt *)((char *)(pkts) + (size_t)(i) * (stride)))
+
+/* statistics of one simulation */
+struct sim_stats {
+  /* updated by the protocol */
+  int total_ACKs_received;
+  int packets_resent;       /* count of the number of packets resent  */
+  int new_ACKs;             /* count of the number of acks correctly received */
+  int packets_received;     /* count of the packets received by receiver */
+  int fast_retransmits;     /* of packets_resent, those resent on duplicate ACKs */
+
+  /* updated by the emulator */
+  int window_full;          /* count of the number of messages dropped due to full window */
+                            /* (and full backlog, see backlog.h) */
+  int backlogged;           /* messages sent after waiting in the backlog */
+  int backlog_max;          /* most messages waiting in one backlog at once */
+  double queue_delay;       /* total time the backlogged messages waited */
+                            /* (added up from the flows, see struct flowsums) */
+  int messages_delivered;   /* messages passed up to layer 5 */
+  int ntolayer3;            /* number sent into layer 3 */
+  int nlost;                /* number lost in media */
+  int ndropped;             /* of those, dropped at a full queue */
+  int ncorrupt;             /* number corrupted by media*/
+  double busy[2];           /* time packets were on their way to the A and to the B */
+                            /* sides, summed over the channels that carry them (idem) */
+  struct hist latency;      /* from the sender accepting a message to its delivery */
+};
+
+/* the sums of floating point statistics are kept per flow while the */
+/* run goes on, and sim_run() adds them up over the flows in order at */
+/* the end, so they come out to the same bits however the events of  */
+/* different flows interleave */
+struct flowsums {
+  double busy[2];           /* of the channels its packets use */
+  double queue_delay;
+  double latency;           /* sum of its messages' latencies */
 };
 
-/* send to A or B (int), packet to send */
-extern void tolayer3(int, struct pkt);  
+/* every kind of random draw has its own generator stream, and every */
+/* flow its own set of them, so changing how often one kind is drawn, */
+/* or what another flow draws, does not shift the others */
+#define  RNG_LOSS        0   /* is a packet lost */
+#define  RNG_CORRUPT     1   /* is a packet corrupted, and where */
+#define  RNG_DELAY       2   /* channel delay of a packet */
+#define  RNG_ARRIVAL     3   /* layer 5 message interarrival times */
+#define  NUM_RNG         4
+
+/* a FIFO of times, growing as needed */
+struct timeq {
+  float *t;
+  int capacity, head, count;
+};
+
+struct event;
+struct evslab;
+struct evlog;
+struct backlog;
+struct checkpoint;
+struct udplink;
+
+/* everything belonging to one run of the emulator.  Simulations share no
+   state, so several can run at once on different threads.  The protocol
+   may read params and time, update stats, and keeps the state of every
+   entity in the block state points to.  The remaining fields belong to
+   the emulator and must not be touched by the protocol.
+
+   The per-entity fields are arrays indexed by entity (2 * params.flows
+   of them), and the per-flow ones by flow, all carved out of one block,
+   so a pass over one field of every flow touches only that field.
+
+   Flows only meet in the shared counters of stats and, with a
+   bottleneck, in the channel.  Events of the same time are taken in
+   flow order and then in the order they were scheduled, and each flow
+   has its own quota of params.nsimmax and its own random streams, so
+   what a flow does never depends on how the others' events interleave
+   with its own.  That lets pdes.c run a simulation as partitions of
+   its flows, one per thread, with the same result. */
+struct simulation {
+  struct sim_params params;     /* parameters of this run */
+  struct sim_stats stats;       /* statistics of this run */
+  float time;                   /* current simulated time */
+  size_t msgstride, pktstride;  /* of the run's arrays of messages and packets */
+  void *state;                  /* protocol state of every entity, statesize() bytes */
+
+  /* emulator private */
+  int nentities;                /* 2 * params.flows */
+  int nsim;                     /* number of messages from 5 to 4 so far */
+  int *generated;               /* [flow] of those, the ones from its layer 5 */
+  struct msg *msgs;             /* the params.burst messages of a layer 5 arrival */
+  struct timeq *sent;           /* [entity] when its undelivered messages were accepted */
+  struct backlog **backlog;     /* [entity] messages waiting for its window, NULL if off */
+  struct event **timerev;       /* [entity] its pending timer event, NULL if off */
+  struct chanmodel chan;        /* the channel model, from params */
+  struct channel *channels;     /* [entity] the channel to it ([side] with a */
+                                /* shared bottleneck) */
+  float *queues;                /* the rings of their queues, NULL if unlimited */
+  int *delivered;               /* [flow] messages delivered */
+  struct flowsums *sums;        /* [flow] */
+  struct rng *streams;          /* [flow * NUM_RNG + kind] random number generators */
+  struct event **evheap;        /* the event list, see emulator.c */
+  int evcount;                  /* number of events in the heap */
+  int evcapacity;               /* allocated size of evheap */
+  unsigned long evseqnext;      /* next insertion sequence number */
+  struct evslab *evslabs;       /* every event slab allocated so far */
+  struct event *evfree;         /* unused events */
+  struct trace_sink trace;      /* where trace_printf() output goes */
+  struct evlog *evlog;          /* binary event log, NULL if off, see evlog.h */
+  double cknext;                /* time of the next checkpoint, 0 for none */
+  struct simulation *whole;     /* for a partition, the simulation it is part of */
+  struct event **pending;       /* a partition's packets on a bottleneck still to */
+  int npending, pendingcap;     /* schedule, in the order they were sent */
+  struct udplink *udp;          /* the real network it runs over, NULL when */
+                                /* simulated, see udp.h */
+};
+
+/* create a simulation from params, ready to run.  returns NULL (after */
+/* printing why) if the protocol rejects the parameters, the random */
+/* number generators fail their self-test or the trace file or event */
+/* log cannot be opened */
+extern struct simulation *sim_create(const struct sim_params *params);
+
+/* a simulation carrying on from checkpoint ck (see checkpoint.h) with */
+/* params, normally ck->params with some of them changed.  returns NULL */
+/* (after printing why) if the checkpoint is damaged, or if params     */
+/* change one of the parameters the saved state was built for: the     */
+/* protocol, window, sequence space, payload, burst, backlog,          */
+/* bidirectional, flows, bottleneck, queue limit, ack mode, checksum,  */
+/* adaptive RTO, congestion control or generator.  with a seed other   */
+/* than the checkpoint's the random number streams start afresh from   */
+/* that seed, so several runs can branch from one checkpoint */
+extern struct simulation *sim_restore(const struct checkpoint *ck, const struct sim_params *params);
+
+/* a simulation of params whose layer 3, timer and layer 5 are those */
+/* of link (see udp.h) instead of simulated ones, with its protocol   */
+/* state initialised and no events.  returns NULL (after printing why) */
+/* if params are invalid */
+extern struct simulation *sim_attach(const struct sim_params *params, struct udplink *link);
+
+/* write everything needed to carry on with the simulation to file. */
+/* returns -1 (after printing why) if it cannot be written */
+extern int sim_checkpoint(const struct simulation *sim, const char *file);
+
+/* run the simulation until no events are left, writing the checkpoints */
+/* params asks for on the way.  with params.partitions above 1 the flows */
+/* are simulated on that many threads (see pdes.h), to the same result */
+extern void sim_run(struct simulation *sim);
+
+/* simulate the next event only.  returns 0, doing nothing, if no */
+/* events are left */
+extern int sim_step(struct simulation *sim);
+
+/* for pdes.c: split sim into n partitions of consecutive flows, each a */
+/* simulation of its own that shares sim's parameters, protocol state */
+/* and per-flow arrays and takes over its flows' events.  with a      */
+/* bottleneck a partition leaves the packets it sends pending, and    */
+/* sim_schedule() gives them their arrival times.  sim_join() adds    */
+/* the partitions' statistics into sim and frees them */
+extern struct simulation **sim_split(struct simulation *sim, int n);
+extern void sim_join(struct simulation *sim, struct simulation **parts, int n);
+
+/* schedule the pending packets of partitions parts[0 .. n - 1] in the */
+/* order the sequential engine would have sent them */
+extern void sim_schedule(struct simulation **parts, int n);
+
+/* simulate the one event that comes first in any of the partitions */
+extern void sim_stepfirst(struct simulation **parts, int n);
+
+/* time of the next event, HUGE_VALF if there is none */
+extern float sim_nexttime(const struct simulation *sim);
+
+/* the earliest time a packet sent at time t or later can arrive */
+extern float sim_lookahead(const struct simulation *sim, float t);
+
+/* simulate the events before time end */
+extern void sim_rununtil(struct simulation *sim, float end);
+
+/* schedule an event at time t that does nothing when it comes up, to */
+/* exercise the event list on its own (see bench.c) */
+extern void sim_idle(struct simulation *sim, float t);
+
+/* print the statistics in the classic emulator format, followed by */
+/* the latency, goodput and utilisation figures */
+extern void sim_report(const struct simulation *sim);
+
+/* write the statistics and figures as one JSON object to file, "-" */
+/* for stdout.  returns -1 (after printing why) if it cannot be created */
+extern int sim_report_json(const struct simulation *sim, const char *file);
+
+/* figures derived from the statistics of a finished run */
+extern double sim_goodput(const struct simulation *sim);        /* messages delivered per time unit */
+extern double sim_utilisation(const struct simulation *sim, int AorB);  /* fraction of the time */
+                                                                /* packets were on their way to side */
+                                                                /* AorB, per channel */
+extern double sim_resentpermsg(const struct simulation *sim);   /* packets resent per message delivered */
+extern double sim_fairness(const struct simulation *sim);       /* Jain's index of the messages */
+                                                                /* delivered per flow, 1 if all equal */
+
+/* free a simulation and its protocol state */
+extern void sim_destroy(struct simulation *sim);
+
+/* send from entity (int) to the other side of its flow, packet to send. */
+/* the packet is copied into the channel, so the caller may reuse it at once */
+extern void tolayer3(struct simulation *sim, int, const struct pkt *);
+
+/* deliver at entity (int), data to deliver and its length */
+extern void tolayer5(struct simulation *sim, int, const char *, int);
+
+/* a random number in [0,1) from flow's stream of RNG_ kind stream */
+extern double jimsrand(struct simulation *sim, int flow, int stream);
+
+/* start timer at entity (int), increment */
+extern void starttimer(struct simulation *sim, int, double);
 
-/* deliver to A or B (int), data to deliver */
-extern void tolayer5(int, char[20]); 
+/* stop timer at entity (int) */
+extern void stoptimer(struct simulation *sim, int);
 
-/* start timer at A or B (int), increment */
-extern void starttimer(int, double);       
+/* the send window of entity (int) has opened: hand it the messages */
+/* waiting in its backlog, through its output routine, until the    */
+/* window is full again.  call it from the input routine after the */
+/* window slides; does nothing without a backlog */
+extern void drainbacklog(struct simulation *sim, int);
 
-/* stop timer at A or B (int) */
-extern void stoptimer(int);               
+#endif
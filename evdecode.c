@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "evlog.h"
+
+/* ******************************************************************
+   Decoder for the binary event logs written with --event-log.
+
+   usage: evdecode [--csv] FILE
+
+   prints one line per record, as text by default or as CSV with a
+   header row.  FILE "-" reads standard input.
+**********************************************************************/
+
+#define BLOCKRECS 4096
+
+static void printrec(const struct evlog_rec *r, int csv)
+{
+  const char *lost = (r->flags & EVLOG_LOST) ? "lost" : "";
+  const char *corrupt = (r->flags & EVLOG_CORRUPTED) ? "corrupted" : "";
+
+  if (csv) {
+    printf("%f,%s,%c,%d,%d,%d,%d,%d\n", r->time, evlog_kindname(r->kind),
+           (r->entity & 1) ? 'B' : 'A', r->entity >> 1, r->seqnum, r->acknum,
+           (r->flags & EVLOG_LOST) != 0, (r->flags & EVLOG_CORRUPTED) != 0);
+    return;
+  }
+  printf("%12f  %-11s  %c", r->time, evlog_kindname(r->kind), (r->entity & 1) ? 'B' : 'A');
+  if (r->entity >> 1)
+    printf("%d", r->entity >> 1);     /* flow, for runs with --flows */
+  switch (r->kind) {
+  case EVLOG_FROM_LAYER5:
+    printf("  msg %d", r->seqnum);
+    break;
+  case EVLOG_TOLAYER3:
+  case EVLOG_FROM_LAYER3:
+    printf("  seq %d ack %d", r->seqnum, r->acknum);
+    break;
+  }
+  if (*lost || *corrupt)
+    printf("  %s%s", lost, corrupt);
+  printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+  struct evlog_header h;
+  struct evlog_rec *block;
+  const char *file = NULL;
+  FILE *fp;
+  size_t n, i;
+  int csv = 0, a;
+
+  for (a = 1; a < argc; a++) {
+    if (strcmp(argv[a], "--csv") == 0)
+      csv = 1;
+    else if (file == NULL)
+      file = argv[a];
+    else
+      file = NULL, a = argc;      /* too many arguments */
+  }
+  if (file == NULL) {
+    fprintf(stderr, "usage: %s [--csv] FILE\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (strcmp(file, "-") == 0)
+    fp = stdin;
+  else if ((fp = fopen(file, "rb")) == NULL) {
+    fprintf(stderr, "cannot open %s\n", file);
+    return EXIT_FAILURE;
+  }
+  if (fread(&h, sizeof(h), 1, fp) != 1 ||
+      memcmp(h.magic, EVLOG_MAGIC, sizeof(h.magic)) != 0) {
+    fprintf(stderr, "%s is not an event log\n", file);
+    return EXIT_FAILURE;
+  }
+  if (h.bom != EVLOG_BOM) {
+    fprintf(stderr, "%s was written on a machine of different byte order\n", file);
+    return EXIT_FAILURE;
+  }
+  if (h.version != EVLOG_VERSION || h.recsize != sizeof(struct evlog_rec)) {
+    fprintf(stderr, "%s: unsupported event log version %u\n", file, (unsigned)h.version);
+    return EXIT_FAILURE;
+  }
+
+  if ((block = malloc(BLOCKRECS * sizeof(struct evlog_rec))) == NULL) {
+    printf("memory allocation for decoder failed.");
+    exit(EXIT_FAILURE);
+  }
+  if (csv)
+    printf("time,kind,entity,flow,seqnum,acknum,lost,corrupted\n");
+  while ((n = fread(block, sizeof(struct evlog_rec), BLOCKRECS, fp)) > 0)
+    for (i = 0; i < n; i++)
+      printrec(&block[i], csv);
+
+  free(block);
+  if (fp != stdin)
+    fclose(fp);
+  return EXIT_SUCCESS;
+}
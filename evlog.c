@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "evlog.h"
+
+/* the ring is split into chunks.  The simulation fills one chunk at a */
+/* time without locking and hands it to the writer thread when full */
+#define EVLOG_CHUNKRECS  4096     /* records per chunk, 64K bytes */
+#define EVLOG_NCHUNKS    16       /* chunks in the ring */
+
+struct evlog {
+  FILE *fp;
+  struct evlog_rec *ring;     /* EVLOG_NCHUNKS chunks of EVLOG_CHUNKRECS */
+  int head;                   /* chunk being filled by the simulation */
+  int fill;                   /* records in the head chunk */
+  int tail;                   /* next chunk for the writer */
+  int pending;                /* full chunks not yet written out */
+  int done;                   /* evlog_close() has been called */
+  int error;                  /* a write failed */
+  pthread_mutex_t lock;
+  pthread_cond_t ready;       /* a chunk became pending, or done was set */
+  pthread_cond_t space;       /* a chunk was written out */
+  pthread_t writer;
+};
+
+static const char *kindnames[EVLOG_NUM_KINDS] = {
+  "FROM_LAYER5", "TOLAYER3", "FROM_LAYER3", "TOLAYER5",
+  "TIMER_START", "TIMER_STOP", "TIMER_FIRE"
+};
+
+const char *evlog_kindname(int kind)
+{
+  if (kind < 0 || kind >= EVLOG_NUM_KINDS)
+    return "?";
+  return kindnames[kind];
+}
+
+static void *writer(void *arg)
+{
+  struct evlog *log = arg;
+  struct evlog_rec *chunk;
+
+  pthread_mutex_lock(&log->lock);
+  while (1) {
+    while (log->pending == 0 && !log->done)
+      pthread_cond_wait(&log->ready, &log->lock);
+    if (log->pending == 0)
+      break;
+    chunk = &log->ring[(size_t)log->tail * EVLOG_CHUNKRECS];
+    pthread_mutex_unlock(&log->lock);
+
+    /* the simulation does not touch a pending chunk, so write it unlocked */
+    if (fwrite(chunk, sizeof(struct evlog_rec), EVLOG_CHUNKRECS, log->fp) != EVLOG_CHUNKRECS)
+      log->error = 1;
+
+    pthread_mutex_lock(&log->lock);
+    log->tail = (log->tail + 1) % EVLOG_NCHUNKS;
+    log->pending--;
+    pthread_cond_signal(&log->space);
+  }
+  pthread_mutex_unlock(&log->lock);
+  return NULL;
+}
+
+struct evlog *evlog_open(const char *file)
+{
+  struct evlog *log;
+  struct evlog_header h;
+
+  log = calloc(1, sizeof(struct evlog));
+  if (log == NULL ||
+      (log->ring = malloc((size_t)EVLOG_NCHUNKS * EVLOG_CHUNKRECS * sizeof(struct evlog_rec))) == NULL) {
+    printf("memory allocation for event log failed.");
+    exit(EXIT_FAILURE);
+  }
+  if ((log->fp = fopen(file, "wb")) == NULL) {
+    fprintf(stderr, "cannot create event log %s\n", file);
+    free(log->ring);
+    free(log);
+    return NULL;
+  }
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, EVLOG_MAGIC, sizeof(h.magic));
+  h.version = EVLOG_VERSION;
+  h.bom = EVLOG_BOM;
+  h.recsize = sizeof(struct evlog_rec);
+  fwrite(&h, sizeof(h), 1, log->fp);
+
+  pthread_mutex_init(&log->lock, NULL);
+  pthread_cond_init(&log->ready, NULL);
+  pthread_cond_init(&log->space, NULL);
+  if (pthread_create(&log->writer, NULL, writer, log) != 0) {
+    fprintf(stderr, "cannot start event log writer\n");
+    fclose(log->fp);
+    free(log->ring);
+    free(log);
+    return NULL;
+  }
+  return log;
+}
+
+void evlog_put(struct evlog *log, float time, int kind, int entity,
+               int flags, int seqnum, int acknum)
+{
+  struct evlog_rec *r;
+
+  r = &log->ring[(size_t)log->head * EVLOG_CHUNKRECS + log->fill];
+  r->time = time;
+  r->kind = (uint8_t)kind;
+  r->flags = (uint8_t)flags;
+  r->entity = (uint16_t)entity;
+  r->seqnum = seqnum;
+  r->acknum = acknum;
+  if (++log->fill < EVLOG_CHUNKRECS)
+    return;
+
+  /* chunk full: pass it to the writer and move on to the next one, */
+  /* waiting only if the writer still has every chunk of the ring */
+  pthread_mutex_lock(&log->lock);
+  log->pending++;
+  pthread_cond_signal(&log->ready);
+  while (log->pending == EVLOG_NCHUNKS)
+    pthread_cond_wait(&log->space, &log->lock);
+  pthread_mutex_unlock(&log->lock);
+  log->head = (log->head + 1) % EVLOG_NCHUNKS;
+  log->fill = 0;
+}
+
+void evlog_close(struct evlog *log)
+{
+  if (log == NULL)
+    return;
+  pthread_mutex_lock(&log->lock);
+  log->done = 1;
+  pthread_cond_signal(&log->ready);
+  pthread_mutex_unlock(&log->lock);
+  pthread_join(log->writer, NULL);
+
+  /* the writer has written every full chunk; the partial one is left */
+  if (log->fill > 0 &&
+      fwrite(&log->ring[(size_t)log->head * EVLOG_CHUNKRECS], sizeof(struct evlog_rec),
+             log->fill, log->fp) != (size_t)log->fill)
+    log->error = 1;
+  if (fclose(log->fp) != 0 || log->error)
+    fprintf(stderr, "error writing event log\n");
+
+  pthread_mutex_destroy(&log->lock);
+  pthread_cond_destroy(&log->ready);
+  pthread_cond_destroy(&log->space);
+  free(log->ring);
+  free(log);
+}
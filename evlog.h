@@ -0,0 +1,72 @@
+#ifndef EVLOG_H
+#define EVLOG_H
+
+#include <stdint.h>
+
+/* ******************************************************************
+   Binary event log.
+
+   An alternative to the text trace for long runs: every event of the
+   simulation is appended as one fixed-size record to a ring buffer in
+   memory, and a writer thread empties the ring to the log file in
+   large blocks while the simulation keeps running.  The file is a
+   struct evlog_header followed by records; evdecode turns it back
+   into text or CSV.
+
+   All fields are written in the byte order of the machine that ran
+   the simulation, which the header records.
+**********************************************************************/
+
+#define EVLOG_MAGIC    "CNAEVLOG"
+#define EVLOG_VERSION  2
+#define EVLOG_BOM      0x01020304u   /* byte order mark */
+
+/* record kinds */
+#define EVLOG_FROM_LAYER5  0   /* message handed to the sender by layer 5 */
+#define EVLOG_TOLAYER3     1   /* packet given to the network */
+#define EVLOG_FROM_LAYER3  2   /* packet arrived at entity */
+#define EVLOG_TOLAYER5     3   /* data delivered to layer 5 */
+#define EVLOG_TIMER_START  4
+#define EVLOG_TIMER_STOP   5
+#define EVLOG_TIMER_FIRE   6
+#define EVLOG_NUM_KINDS    7
+
+/* record flags */
+#define EVLOG_LOST       0x01  /* packet dropped by the network */
+#define EVLOG_CORRUPTED  0x02  /* packet corrupted by the network */
+
+struct evlog_header {
+  char magic[8];           /* EVLOG_MAGIC, not nul terminated */
+  uint32_t version;        /* EVLOG_VERSION */
+  uint32_t bom;            /* EVLOG_BOM as written by the producer */
+  uint32_t recsize;        /* sizeof(struct evlog_rec) */
+  uint32_t reserved;
+};
+
+struct evlog_rec {
+  float time;              /* simulated time of the event */
+  uint8_t kind;            /* EVLOG_... kind */
+  uint8_t flags;           /* EVLOG_LOST, EVLOG_CORRUPTED */
+  uint16_t entity;         /* 2 * flow + A or B */
+  int32_t seqnum;          /* packet seqnum, message number for FROM_LAYER5 */
+  int32_t acknum;          /* packet acknum */
+};
+
+struct evlog;
+
+/* create file and start its writer thread.  returns NULL (after */
+/* printing why) if the file cannot be created */
+extern struct evlog *evlog_open(const char *file);
+
+/* append one record; blocks only if the writer has fallen a whole */
+/* ring behind */
+extern void evlog_put(struct evlog *log, float time, int kind, int entity,
+                      int flags, int seqnum, int acknum);
+
+/* write out everything logged, stop the writer and close the file */
+extern void evlog_close(struct evlog *log);
+
+/* name of record kind, "?" if unknown */
+extern const char *evlog_kindname(int kind);
+
+#endif
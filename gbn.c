@@ -1,12 +1,17 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdbool.h>
 #include "emulator.h"
 #include "gbn.h"
+#include "ltimer.h"
+#include "rto.h"
+#include "cc.h"
+#include "seq.h"
 
 /* ******************************************************************
    Go Back N protocol.  Adapted from J.F.Kurose
-   ALTERNATING BIT AND GO-BACK-N NETWORK EMULATOR: VERSION 1.2  
+   ALTERNATING BIT AND GO-BACK-N NETWORK EMULATOR: VERSION 1.2
 
    Network properties:
    - one way network delay averages five time units (longer if there
@@ -16,260 +21,438 @@
    - packets will be delivered in the order in which they were sent
    (although some can be lost).
 
-   Modifications: 
-   - removed bidirectional GBN code and other code not used by prac. 
+   Modifications:
+   - removed bidirectional GBN code and other code not used by prac.
    - fixed C style to adhere to current programming style
    - added GBN implementation
+   - window and sequence space sizes are run-time parameters
+   - bidirectional again (--bidirectional): each entity is a sender and
+     a receiver, and data packets carry the ACK of the reverse direction
 **********************************************************************/
 
 #define RTT  16.0       /* round trip time.  MUST BE SET TO 16.0 when submitting assignment */
-#define WINDOWSIZE 6    /* the maximum number of buffered unacked packet */
-#define SEQSPACE 7      /* the min sequence space for GBN must be at least windowsize + 1 */
+                        /* (the initial timeout when --adaptive-rto is on) */
+#define WINDOWSIZE 6    /* default maximum number of buffered unacked packet (--window) */
 #define NOTINUSE (-1)   /* used to fill header fields that are not being used */
 
-/* generic procedure to compute the checksum of a packet.  Used by both sender and receiver  
-   the simulator will overwrite part of your packet with 'z's.  It will not overwrite your 
-   original checksum.  This procedure must generate a different checksum to the original if
-   the packet is corrupted.
-*/
-int ComputeChecksum(struct pkt packet)
-{
-  int checksum = 0;
-  int i;
+/* the logical timers sharing an entity's timer */
+#define RETX_TIMER 0    /* retransmission of the window */
+#define ACK_TIMER  1    /* delayed ACK */
+#define NTIMERS    2
 
-  checksum = packet.seqnum;
-  checksum += packet.acknum;
-  for ( i=0; i<20; i++ ) 
-    checksum += (int)(packet.payload[i]);
+/* the sequence space must be at least windowsize + 1, and defaults to */
+/* that (see seq_default()) */
+static int configure(struct sim_params *p)
+{
+  if (p->windowsize == 0)
+    p->windowsize = WINDOWSIZE;
+  if (p->seqspace == 0)
+    p->seqspace = seq_default(p->windowsize + 1);
+  if (p->windowsize < 1) {
+    fprintf(stderr, "gbn: window must be at least 1\n");
+    return -1;
+  }
+  if (p->seqspace < p->windowsize + 1) {
+    fprintf(stderr, "gbn: sequence space %d is too small for window %d, need at least %d\n",
+            p->seqspace, p->windowsize, p->windowsize + 1);
+    return -1;
+  }
+  if (!seq_sizeok(p->seqspace)) {
+    fprintf(stderr, "gbn: this build only supports power of two sequence spaces\n");
+    return -1;
+  }
+  if (p->congestion != CC_NONE) {
+    fprintf(stderr, "gbn: congestion control is only implemented for sr\n");
+    return -1;
+  }
+  return 0;
+}
 
-  return checksum;
+/* the state of every entity, as one array per field indexed by entity */
+/* (see entity_of() in emulator.h), so a field of thousands of flows   */
+/* stays dense.  the per-packet arrays give each entity ring slots,    */
+/* those of entity e from SLOT(g, e, 0) on.  without --bidirectional A */
+/* only sends and B only receives */
+struct gbn_state {
+  int windowsize;                 /* the maximum number of buffered unacked packet */
+  struct seqspace seq;            /* sequence numbers */
+  int ring, ringmask;             /* each buffer holds ring = ringmask + 1 >= windowsize packets */
+
+  /* the sending halves */
+  struct pkt *buffer;             /* [slot] packets waiting for ACK, see pkt_at() */
+  float *sendtime;                /* [slot] when each packet in the window was first sent */
+  bool *resent;                   /* [slot] packet was sent more than once, so gives no RTT sample */
+  int *windowfirst, *windowlast;  /* [e] ring indexes of the first/last packet awaiting ACK */
+  int *windowcount;               /* [e] the number of packets currently awaiting an ACK */
+  int *nextseqnum;                /* [e] the next sequence number to be used by the sender */
+  struct rto *rto;                /* [e] retransmission timeout, see rto.h */
+
+  /* the receiving halves */
+  int *expectedseqnum;            /* [e] the sequence number expected next by the receiver */
+  int *acknextseqnum;             /* [e] the (unused) sequence number of the next ACK packet */
+  int *unacked;                   /* [e] in-order packets received since the last ACK (delayed ACKs) */
+
+  /* RETX_TIMER and ACK_TIMER of each entity, see ltimer.h */
+  struct ltimers *timers;         /* [e] */
+  float *deadline;                /* [e * NTIMERS + id], the arrays of timers[e] */
+  unsigned long *stamp;
+  int *heap, *pos;
+};
+
+#define NAME(e) ('A' + entity_side(e))
+
+/* the per-packet index of slot i of entity e's ring */
+#define SLOT(g, e, i)  ((e) * (g)->ring + (i))
+
+/* a standalone ACK, or data, has just ACKed everything received so far */
+static void acksent(struct simulation *sim, struct gbn_state *g, int e)
+{
+  g->unacked[e] = 0;
+  ltimer_stop(sim, &g->timers[e], ACK_TIMER);
 }
 
-bool IsCorrupted(struct pkt packet)
+/* send data packet p.  in bidirectional runs it also carries the */
+/* cumulative ACK of the data received so far, refreshed every time */
+static void senddata(struct simulation *sim, struct gbn_state *g, int e, struct pkt *p)
 {
-  if (packet.checksum == ComputeChecksum(packet))
-    return (false);
-  else
-    return (true);
+  if (sim->params.bidirectional) {
+    p->flags = PKT_DATA | PKT_ACK;
+    p->acknum = SEQ_PREV(&g->seq, g->expectedseqnum[e]);
+    p->checksum = ComputeChecksum(sim, p);
+    acksent(sim, g, e);
+  }
+  tolayer3(sim, e, p);
 }
 
+/* ACK every packet received in order so far */
+static void sendack(struct simulation *sim, struct gbn_state *g, int e)
+{
+  struct pkt sendpkt;
 
-/********* Sender (A) variables and functions ************/
+  sendpkt.acknum = SEQ_PREV(&g->seq, g->expectedseqnum[e]);
 
-static struct pkt buffer[WINDOWSIZE];  /* array for storing packets waiting for ACK */
-static int windowfirst, windowlast;    /* array indexes of the first/last packet awaiting ACK */
-static int windowcount;                /* the number of packets currently awaiting an ACK */
-static int A_nextseqnum;               /* the next sequence number to be used by the sender */
+  /* create packet */
+  sendpkt.seqnum = g->acknextseqnum[e];
+  g->acknextseqnum[e] = (g->acknextseqnum[e] + 1) % 2;
+  sendpkt.flags = PKT_ACK;
 
-/* called from layer 5 (application layer), passed the message to be sent to other side */
-void A_output(struct msg message)
-{
-  struct pkt sendpkt;
-  int i;
+  /* we don't have any data to send.  fill payload with 0's */
+  sendpkt.length = ACKLEN;
+  memset(sendpkt.payload, '0', ACKLEN);
 
-  /* if not blocked waiting on ACK */
-  if ( windowcount < WINDOWSIZE) {
-    if (TRACE > 1)
-      printf("----A: New message arrives, send window is not full, send new messge to layer3!\n");
+  /* computer checksum */
+  sendpkt.checksum = ComputeChecksum(sim, &sendpkt);
 
-    /* create packet */
-    sendpkt.seqnum = A_nextseqnum;
-    sendpkt.acknum = NOTINUSE;
-    for ( i=0; i<20 ; i++ ) 
-      sendpkt.payload[i] = message.data[i];
-    sendpkt.checksum = ComputeChecksum(sendpkt); 
+  /* send out packet */
+  tolayer3(sim, e, &sendpkt);
+  acksent(sim, g, e);
+}
 
-    /* put packet in window buffer */
+/* called from layer 5 (application layer), passed the messages to be sent to other side */
+static int output(struct simulation *sim, struct gbn_state *g, int e, const struct msg *msgs, int n)
+{
+  const struct msg *m;
+  struct pkt *sendpkt;
+  int i, slot;
+
+  for (i = 0; i < n; i++) {
+    /* if blocked,  window is full */
+    if (g->windowcount[e] == g->windowsize) {
+      if (TRACING(sim, 1))
+        trace_printf(sim, "----%c: New message arrives, send window is full\n", NAME(e));
+      break;
+    }
+    if (TRACING(sim, 2))
+      trace_printf(sim, "----%c: New message arrives, send window is not full, send new messge to layer3!\n", NAME(e));
+
+    /* create packet in its window buffer slot */
     /* windowlast will always be 0 for alternating bit; but not for GoBackN */
-    windowlast = (windowlast + 1) % WINDOWSIZE; 
-    buffer[windowlast] = sendpkt;
-    windowcount++;
+    g->windowlast[e] = (g->windowlast[e] + 1) & g->ringmask;
+    slot = SLOT(g, e, g->windowlast[e]);
+    sendpkt = pkt_at(g->buffer, sim->pktstride, slot);
+    m = msg_at(msgs, sim->msgstride, i);
+    sendpkt->seqnum = g->nextseqnum[e];
+    sendpkt->acknum = NOTINUSE;
+    sendpkt->flags = PKT_DATA;
+    sendpkt->length = m->length;
+    memcpy(sendpkt->payload, m->data, m->length);
+    if (!sim->params.bidirectional)   /* else senddata() fills in the ACK */
+      sendpkt->checksum = ComputeChecksum(sim, sendpkt);
+    g->sendtime[slot] = sim->time;
+    g->resent[slot] = false;
+    g->windowcount[e]++;
 
     /* send out packet */
-    if (TRACE > 0)
-      printf("Sending packet %d to layer 3\n", sendpkt.seqnum);
-    tolayer3 (A, sendpkt);
+    if (TRACING(sim, 1))
+      trace_printf(sim, "Sending packet %d to layer 3\n", sendpkt->seqnum);
+    senddata(sim, g, e, sendpkt);
 
     /* start timer if first packet in window */
-    if (windowcount == 1)
-      starttimer(A,RTT);
+    if (g->windowcount[e] == 1)
+      ltimer_start(sim, &g->timers[e], RETX_TIMER, rto_timeout(&g->rto[e]));
 
     /* get next sequence number, wrap back to 0 */
-    A_nextseqnum = (A_nextseqnum + 1) % SEQSPACE;  
-  }
-  /* if blocked,  window is full */
-  else {
-    if (TRACE > 0)
-      printf("----A: New message arrives, send window is full\n");
-    window_full++;
+    g->nextseqnum[e] = SEQ_ADD(&g->seq, g->nextseqnum[e], 1);
   }
+  return i;
 }
 
 
-/* called from layer 3, when a packet arrives for layer 4 
-   In this practical this will always be an ACK as B never sends data.
-*/
-void A_input(struct pkt packet)
+/* the ACK of packet, standalone or carried by data, for the sending half */
+static void ackinput(struct simulation *sim, struct gbn_state *g, int e, const struct pkt *packet)
 {
   int ackcount = 0;
   int i;
 
-  /* if received ACK is not corrupted */ 
-  if (!IsCorrupted(packet)) {
-    if (TRACE > 0)
-      printf("----A: uncorrupted ACK %d is received\n",packet.acknum);
-    total_ACKs_received++;
-
-    /* check if new ACK or duplicate */
-    if (windowcount != 0) {
-          int seqfirst = buffer[windowfirst].seqnum;
-          int seqlast = buffer[windowlast].seqnum;
-          /* check case when seqnum has and hasn't wrapped */
-          if (((seqfirst <= seqlast) && (packet.acknum >= seqfirst && packet.acknum <= seqlast)) ||
-              ((seqfirst > seqlast) && (packet.acknum >= seqfirst || packet.acknum <= seqlast))) {
-
-            /* packet is a new ACK */
-            if (TRACE > 0)
-              printf("----A: ACK %d is not a duplicate\n",packet.acknum);
-            new_ACKs++;
-
-            /* cumulative acknowledgement - determine how many packets are ACKed */
-            if (packet.acknum >= seqfirst)
-              ackcount = packet.acknum + 1 - seqfirst;
-            else
-              ackcount = SEQSPACE - seqfirst + packet.acknum;
-
-	    /* slide window by the number of packets ACKed */
-            windowfirst = (windowfirst + ackcount) % WINDOWSIZE;
-
-            /* delete the acked packets from window buffer */
-            for (i=0; i<ackcount; i++)
-              windowcount--;
-
-	    /* start timer again if there are still more unacked packets in window */
-            stoptimer(A);
-            if (windowcount > 0)
-              starttimer(A, RTT);
-
-          }
+  if (TRACING(sim, 1))
+    trace_printf(sim, "----%c: uncorrupted ACK %d is received\n", NAME(e), packet->acknum);
+  sim->stats.total_ACKs_received++;
+
+  /* check if new ACK or duplicate */
+  if (g->windowcount[e] != 0) {
+        int seqfirst = pkt_at(g->buffer, sim->pktstride, SLOT(g, e, g->windowfirst[e]))->seqnum;
+        int seqlast = pkt_at(g->buffer, sim->pktstride, SLOT(g, e, g->windowlast[e]))->seqnum;
+        /* check case when seqnum has and hasn't wrapped */
+        if (((seqfirst <= seqlast) && (packet->acknum >= seqfirst && packet->acknum <= seqlast)) ||
+            ((seqfirst > seqlast) && (packet->acknum >= seqfirst || packet->acknum <= seqlast))) {
+
+          /* packet is a new ACK */
+          if (TRACING(sim, 1))
+            trace_printf(sim, "----%c: ACK %d is not a duplicate\n", NAME(e), packet->acknum);
+          sim->stats.new_ACKs++;
+
+          /* cumulative acknowledgement - determine how many packets are ACKed */
+          ackcount = SEQ_DIST(&g->seq, seqfirst, packet->acknum) + 1;
+
+          /* time the newest packet ACKed, unless it was resent (Karn) */
+          i = SLOT(g, e, (g->windowfirst[e] + ackcount - 1) & g->ringmask);
+          if (!g->resent[i])
+            rto_sample(&g->rto[e], sim->time - g->sendtime[i]);
+          rto_ack(&g->rto[e]);
+
+          /* slide window by the number of packets ACKed */
+          g->windowfirst[e] = (g->windowfirst[e] + ackcount) & g->ringmask;
+
+          /* delete the acked packets from window buffer */
+          for (i=0; i<ackcount; i++)
+            g->windowcount[e]--;
+
+          /* start timer again if there are still more unacked packets in window */
+          ltimer_stop(sim, &g->timers[e], RETX_TIMER);
+          if (g->windowcount[e] > 0)
+            ltimer_start(sim, &g->timers[e], RETX_TIMER, rto_timeout(&g->rto[e]));
+
+          /* the window has room again for messages waiting in the backlog */
+          drainbacklog(sim, e);
         }
-        else
-          if (TRACE > 0)
-        printf ("----A: duplicate ACK received, do nothing!\n");
-  }
-  else 
-    if (TRACE > 0)
-      printf ("----A: corrupted ACK is received, do nothing!\n");
+      }
+      else
+        if (TRACING(sim, 1))
+      trace_printf(sim, "----%c: duplicate ACK received, do nothing!\n", NAME(e));
 }
 
-/* called when A's timer goes off */
-void A_timerinterrupt(void)
+/* a data packet, for the receiving half */
+static void datainput(struct simulation *sim, struct gbn_state *g, int e, const struct pkt *packet)
 {
-  int i;
-
-  if (TRACE > 0)
-    printf("----A: time out,resend packets!\n");
+  /* if received packet is in order */
+  if (packet->seqnum == g->expectedseqnum[e]) {
+    if (TRACING(sim, 1))
+      trace_printf(sim, "----%c: packet %d is correctly received, send ACK!\n", NAME(e), packet->seqnum);
+    sim->stats.packets_received++;
 
-  for(i=0; i<windowcount; i++) {
-
-    if (TRACE > 0)
-      printf ("---A: resending packet %d\n", (buffer[(windowfirst+i) % WINDOWSIZE]).seqnum);
+    /* deliver to receiving application */
+    tolayer5(sim, e, packet->payload, packet->length);
 
-    tolayer3(A,buffer[(windowfirst+i) % WINDOWSIZE]);
-    packets_resent++;
-    if (i==0) starttimer(A,RTT);
+    /* update state variables */
+    g->expectedseqnum[e] = SEQ_ADD(&g->seq, g->expectedseqnum[e], 1);
+
+    /* send an ACK for the received packet now, or later with the ACK */
+    /* timer covering the wait, see ack_due() */
+    if (ack_due(sim, ++g->unacked[e]))
+      sendack(sim, g, e);
+    else if (!ltimer_running(&g->timers[e], ACK_TIMER))
+      ltimer_start(sim, &g->timers[e], ACK_TIMER, sim->params.ackdelay);
+  }
+  else {
+    /* packet is out of order resend last ACK, at once */
+    if (TRACING(sim, 1))
+      trace_printf(sim, "----%c: packet corrupted or not expected sequence number, resend ACK!\n", NAME(e));
+    sendack(sim, g, e);
   }
-}       
+}
 
+/* called from layer 3, when a packet arrives for layer 4 */
+static void input(struct simulation *sim, struct gbn_state *g, int e, const struct pkt *packet)
+{
+  if (IsCorrupted(sim, packet)) {
+    /* a receive-only entity knows a corrupted packet was data, and */
+    /* answers with the last ACK.  anyone else may be looking at a  */
+    /* corrupted ACK, which must not be answered: ACKs of ACKs could */
+    /* bounce between A and B for ever */
+    if (!sim->params.bidirectional && entity_side(e) == B) {
+      if (TRACING(sim, 1))
+        trace_printf(sim, "----B: packet corrupted or not expected sequence number, resend ACK!\n");
+      sendack(sim, g, e);
+    }
+    else if (TRACING(sim, 1))
+      trace_printf(sim, "----%c: corrupted %s is received, do nothing!\n", NAME(e),
+                   sim->params.bidirectional ? "packet" : "ACK");
+    return;
+  }
 
+  if (packet->flags & PKT_ACK)
+    ackinput(sim, g, e, packet);
+  if (packet->flags & PKT_DATA)
+    datainput(sim, g, e, packet);
+}
 
-/* the following routine will be called once (only) before any other */
-/* entity A routines are called. You can use it to do any initialization */
-void A_init(void)
+/* called when the entity's timer goes off */
+static void timerinterrupt(struct simulation *sim, struct gbn_state *g, int e)
 {
-  /* initialise A's window, buffer and sequence number */
-  A_nextseqnum = 0;  /* A starts with seq num 0, do not change this */
-  windowfirst = 0;
-  windowlast = -1;   /* windowlast is where the last packet sent is stored.  
-		     new packets are placed in winlast + 1 
-		     so initially this is set to -1
-		   */
-  windowcount = 0;
+  int id, i, slot;
+
+  while ((id = ltimer_expired(sim, &g->timers[e])) >= 0) {
+    if (id == ACK_TIMER) {      /* the delayed ACK is due */
+      if (g->unacked[e] > 0)
+        sendack(sim, g, e);
+      continue;
+    }
+
+    if (TRACING(sim, 1))
+      trace_printf(sim, "----%c: time out,resend packets!\n", NAME(e));
+    rto_backoff(&g->rto[e]);
+
+    for(i=0; i<g->windowcount[e]; i++) {
+      slot = SLOT(g, e, (g->windowfirst[e]+i) & g->ringmask);
+
+      if (TRACING(sim, 1))
+        trace_printf(sim, "---%c: resending packet %d\n", NAME(e),
+                     pkt_at(g->buffer, sim->pktstride, slot)->seqnum);
+
+      senddata(sim, g, e, pkt_at(g->buffer, sim->pktstride, slot));
+      g->resent[slot] = true;
+      sim->stats.packets_resent++;
+      if (i==0) ltimer_start(sim, &g->timers[e], RETX_TIMER, rto_timeout(&g->rto[e]));
+    }
+  }
 }
 
 
 
-/********* Receiver (B)  variables and procedures ************/
-
-static int expectedseqnum; /* the sequence number expected next by the receiver */
-static int B_nextseqnum;   /* the sequence number for the next packets sent by B */
+/* the send buffer rounded up to a power of two, so indexes wrap with a mask */
+static int ringsize(const struct sim_params *params)
+{
+  int ring;
 
+  for (ring = 1; ring < params->windowsize; ring *= 2)
+    ;
+  return ring;
+}
 
-/* called from layer 3, when a packet arrives for layer 4 at B*/
-void B_input(struct pkt packet)
+/* the state and its arrays are one block, widest elements first */
+static size_t statesize(const struct sim_params *params)
 {
-  struct pkt sendpkt;
-  int i;
+  size_t n = 2 * params->flows, ring = ringsize(params);
 
-  /* if not corrupted and received packet is in order */
-  if  ( (!IsCorrupted(packet))  && (packet.seqnum == expectedseqnum) ) {
-    if (TRACE > 0)
-      printf("----B: packet %d is correctly received, send ACK!\n",packet.seqnum);
-    packets_received++;
-
-    /* deliver to receiving application */
-    tolayer5(B, packet.payload);
+  return sizeof(struct gbn_state) +
+         n * (sizeof(struct rto) + sizeof(struct ltimers) +
+              NTIMERS * (sizeof(unsigned long) + sizeof(float) + 2 * sizeof(int)) +
+              7 * sizeof(int) +
+              ring * (pkt_stride(params) + sizeof(float) + sizeof(bool)));
+}
 
-    /* send an ACK for the received packet */
-    sendpkt.acknum = expectedseqnum;
+/* point the state at the arrays after it in its block */
+static void relink(struct simulation *sim)
+{
+  struct gbn_state *g = sim->state;
+  size_t n = 2 * sim->params.flows, slots = n * ringsize(&sim->params);
+  char *arrays;
+  size_t e;
+
+  arrays = (char *)(g + 1);
+  g->rto = (struct rto *)arrays;
+  arrays += n * sizeof(struct rto);
+  g->timers = (struct ltimers *)arrays;
+  arrays += n * sizeof(struct ltimers);
+  g->stamp = (unsigned long *)arrays;
+  arrays += n * NTIMERS * sizeof(unsigned long);
+  g->buffer = (struct pkt *)arrays;
+  arrays += slots * sim->pktstride;
+  g->sendtime = (float *)arrays;
+  arrays += slots * sizeof(float);
+  g->deadline = (float *)arrays;
+  arrays += n * NTIMERS * sizeof(float);
+  g->heap = (int *)arrays;
+  arrays += n * NTIMERS * sizeof(int);
+  g->pos = (int *)arrays;
+  arrays += n * NTIMERS * sizeof(int);
+  g->windowfirst = (int *)arrays;
+  g->windowlast = g->windowfirst + n;
+  g->windowcount = g->windowlast + n;
+  g->nextseqnum = g->windowcount + n;
+  g->expectedseqnum = g->nextseqnum + n;
+  g->acknextseqnum = g->expectedseqnum + n;
+  g->unacked = g->acknextseqnum + n;
+  arrays += 7 * n * sizeof(int);
+  g->resent = (bool *)arrays;
+
+  g->windowsize = sim->params.windowsize;
+  seq_init(&g->seq, sim->params.seqspace);
+  g->ring = ringsize(&sim->params);
+  g->ringmask = g->ring - 1;
+  for (e = 0; e < n; e++)
+    ltimer_relink(&g->timers[e], g->deadline + e * NTIMERS, g->stamp + e * NTIMERS,
+                  g->heap + e * NTIMERS, g->pos + e * NTIMERS);
+}
 
-    /* update state variables */
-    expectedseqnum = (expectedseqnum + 1) % SEQSPACE;        
-  }
-  else {
-    /* packet is corrupted or out of order resend last ACK */
-    if (TRACE > 0) 
-      printf("----B: packet corrupted or not expected sequence number, resend ACK!\n");
-    if (expectedseqnum == 0)
-      sendpkt.acknum = SEQSPACE - 1;
-    else
-      sendpkt.acknum = expectedseqnum - 1;
-  }
+/* the following routine will be called once (only) before any other */
+/* routines of the entity are called. You can use it to do any initialization */
+static void init(struct simulation *sim, int entity)
+{
+  struct gbn_state *g = sim->state;
+  const int e = entity;
 
-  /* create packet */
-  sendpkt.seqnum = B_nextseqnum;
-  B_nextseqnum = (B_nextseqnum + 1) % 2;
-    
-  /* we don't have any data to send.  fill payload with 0's */
-  for ( i=0; i<20 ; i++ ) 
-    sendpkt.payload[i] = '0';  
+  ltimer_init(&g->timers[e], e, NTIMERS, g->deadline + e * NTIMERS, g->stamp + e * NTIMERS,
+              g->heap + e * NTIMERS, g->pos + e * NTIMERS);
 
-  /* computer checksum */
-  sendpkt.checksum = ComputeChecksum(sendpkt); 
+  /* initialise the window, buffer and sequence number */
+  g->nextseqnum[e] = 0;    /* A starts with seq num 0, do not change this */
+  g->windowfirst[e] = 0;
+  g->windowlast[e] = -1;   /* windowlast is where the last packet sent is stored.
+		     new packets are placed in winlast + 1
+		     so initially this is set to -1
+		   */
+  g->windowcount[e] = 0;
+  rto_init(&g->rto[e], sim->params.adaptiverto, RTT);
 
-  /* send out packet */
-  tolayer3 (B, sendpkt);
+  g->expectedseqnum[e] = 0;
+  g->acknextseqnum[e] = 1;
+  g->unacked[e] = 0;
 }
 
-/* the following routine will be called once (only) before any other */
-/* entity B routines are called. You can use it to do any initialization */
-void B_init(void)
+/* the entry points, for either side of any flow */
+
+static int entry_output(struct simulation *sim, int entity, const struct msg *msgs, int n)
 {
-  expectedseqnum = 0;
-  B_nextseqnum = 1;
+  return output(sim, sim->state, entity, msgs, n);
 }
 
-/******************************************************************************
- * The following functions need be completed only for bi-directional messages *
- *****************************************************************************/
-
-/* Note that with simplex transfer from a-to-B, there is no B_output() */
-void B_output(struct msg message)  
+static void entry_input(struct simulation *sim, int entity, const struct pkt *packet)
 {
+  input(sim, sim->state, entity, packet);
 }
 
-/* called when B's timer goes off */
-void B_timerinterrupt(void)
+static void entry_timerinterrupt(struct simulation *sim, int entity)
 {
+  timerinterrupt(sim, sim->state, entity);
 }
 
+const struct protocol gbn_protocol = {
+  "gbn", "Go Back N",
+  configure,
+  init,
+  entry_output,
+  entry_input,
+  entry_timerinterrupt,
+  statesize, relink
+};
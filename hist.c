@@ -0,0 +1,129 @@
+#include <string.h>
+#include "hist.h"
+
+/* index of the highest set bit of t, which is not 0 */
+#if defined(__GNUC__)
+#define msb64(t) (63 - __builtin_clzll(t))
+#else
+static int msb64(uint64_t t)
+{
+  int n = 0;
+
+  while (t >>= 1)
+    n++;
+  return n;
+}
+#endif
+
+static int bucketof(uint64_t ticks)
+{
+  int shift;
+
+  if (ticks < 2 * HIST_HALF)
+    return (int)ticks;
+  if (ticks >= HIST_MAXTICKS)
+    return HIST_BUCKETS - 1;
+  /* ticks >> shift is in HIST_HALF .. 2 * HIST_HALF - 1 */
+  shift = msb64(ticks) - HIST_SUBBITS;
+  return 2 * HIST_HALF + (shift - 1) * HIST_HALF + (int)(ticks >> shift) - HIST_HALF;
+}
+
+/* the ticks bucket i covers, low to high inclusive */
+static void bucketrange(int i, uint64_t *low, uint64_t *high)
+{
+  int shift;
+  uint64_t sub;
+
+  if (i < 2 * HIST_HALF) {
+    *low = *high = i;
+    return;
+  }
+  shift = (i - 2 * HIST_HALF) / HIST_HALF + 1;
+  sub = HIST_HALF + (i - 2 * HIST_HALF) % HIST_HALF;
+  *low = sub << shift;
+  *high = ((sub + 1) << shift) - 1;
+}
+
+void hist_init(struct hist *h)
+{
+  memset(h, 0, sizeof(*h));
+}
+
+void hist_add(struct hist *h, const struct hist *from)
+{
+  int i;
+
+  if (from->count == 0)
+    return;
+  if (h->count == 0 || from->min < h->min)
+    h->min = from->min;
+  if (h->count == 0 || from->max > h->max)
+    h->max = from->max;
+  h->count += from->count;
+  h->sum += from->sum;
+  for (i = 0; i < HIST_BUCKETS; i++)
+    h->buckets[i] += from->buckets[i];
+}
+
+void hist_record(struct hist *h, double value)
+{
+  if (value < 0)
+    value = 0;
+  if (h->count == 0 || value < h->min)
+    h->min = value;
+  if (h->count == 0 || value > h->max)
+    h->max = value;
+  h->count++;
+  h->sum += value;
+  h->buckets[bucketof((uint64_t)(value * HIST_TICKS))]++;
+}
+
+double hist_percentile(const struct hist *h, double p)
+{
+  uint64_t rank, seen = 0, low, high;
+  double v;
+  int i;
+
+  if (h->count == 0)
+    return 0.0;
+  rank = (uint64_t)(p * h->count + 0.5);
+  if (rank < 1)
+    rank = 1;
+  if (rank > h->count)
+    rank = h->count;
+  for (i = 0; i < HIST_BUCKETS; i++) {
+    seen += h->buckets[i];
+    if (seen >= rank)
+      break;
+  }
+  /* the middle of the bucket, inside what was actually recorded */
+  bucketrange(i, &low, &high);
+  v = (low + high + 1) / 2.0 / HIST_TICKS;
+  if (v < h->min)
+    v = h->min;
+  if (v > h->max)
+    v = h->max;
+  return v;
+}
+
+void hist_json(const struct hist *h, FILE *fp)
+{
+  uint64_t low, high;
+  int i, first = 1;
+
+  fprintf(fp, "{\"count\": %llu, \"min\": %.6g, \"mean\": %.6g, \"max\": %.6g, "
+          "\"p50\": %.6g, \"p90\": %.6g, \"p99\": %.6g, \"p999\": %.6g,\n     \"buckets\": [",
+          (unsigned long long)h->count, h->min, hist_mean(h), h->max,
+          hist_percentile(h, 0.5), hist_percentile(h, 0.9),
+          hist_percentile(h, 0.99), hist_percentile(h, 0.999));
+  for (i = 0; i < HIST_BUCKETS; i++) {
+    if (h->buckets[i] == 0)
+      continue;
+    bucketrange(i, &low, &high);
+    fprintf(fp, "%s[%.6g, %.6g, %llu]", first ? "" : ", ",
+            (double)low / HIST_TICKS, (double)(high + 1) / HIST_TICKS,
+            (unsigned long long)h->buckets[i]);
+    first = 0;
+  }
+  fprintf(fp, "]}");
+}
@@ -0,0 +1,53 @@
+#ifndef HIST_H
+#define HIST_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* ******************************************************************
+   Log-linear histograms of non-negative values, in the style of HDR
+   histograms.
+
+   Values are counted in ticks of 1/HIST_TICKS time units.  The first
+   2 * HIST_HALF buckets hold 0 .. 2 * HIST_HALF - 1 ticks exactly; after
+   that every power of two range of ticks is split into HIST_HALF
+   equal buckets, so a bucket is never wider than 1/HIST_HALF of the
+   values in it.  A percentile is therefore within 1% of the exact one
+   (HIST_HALF = 64 gives 0.8%) while the whole range up to HIST_MAXTICKS
+   takes a few thousand counters.  Larger values go in the last bucket;
+   the exact minimum, maximum and mean are kept as well.
+**********************************************************************/
+
+#define HIST_TICKS     1000           /* ticks per time unit */
+#define HIST_SUBBITS   6              /* log2 of HIST_HALF */
+#define HIST_HALF      (1 << HIST_SUBBITS)
+#define HIST_RANGES    34             /* power of two ranges after the linear start */
+#define HIST_MAXTICKS  ((uint64_t)2 * HIST_HALF << HIST_RANGES)
+#define HIST_BUCKETS   (2 * HIST_HALF + HIST_RANGES * HIST_HALF)
+
+struct hist {
+  uint64_t count;                     /* values recorded */
+  double sum, min, max;
+  uint64_t buckets[HIST_BUCKETS];
+};
+
+/* empty h; a zeroed struct hist is empty too */
+extern void hist_init(struct hist *h);
+
+extern void hist_record(struct hist *h, double value);
+
+/* add the values recorded in from to h */
+extern void hist_add(struct hist *h, const struct hist *from);
+
+/* the value below which a fraction p (0..1) of the values lie, */
+/* 0 for an empty histogram */
+extern double hist_percentile(const struct hist *h, double p);
+
+#define hist_mean(h) ((h)->count ? (h)->sum / (h)->count : 0.0)
+
+/* write h as a JSON object: count, min, mean, max, p50, p90, p99, */
+/* p999 and the non-empty buckets as [low, high, count], each for   */
+/* the values from low up to but not including high */
+extern void hist_json(const struct hist *h, FILE *fp);
+
+#endif
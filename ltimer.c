@@ -0,0 +1,154 @@
+#include "ltimer.h"
+
+void ltimer_init(struct ltimers *lt, int entity, int n, float *deadline,
+                 unsigned long *stamp, int *heap, int *pos)
+{
+  int i;
+
+  lt->entity = entity;
+  lt->n = n;
+  lt->deadline = deadline;
+  lt->stamp = stamp;
+  lt->heap = heap;
+  lt->pos = pos;
+  lt->count = 0;
+  lt->nextstamp = 0;
+  lt->armed = 0.0;
+  lt->running = 0;
+  lt->firing = 0;
+  for (i = 0; i < n; i++)
+    pos[i] = -1;
+}
+
+void ltimer_relink(struct ltimers *lt, float *deadline, unsigned long *stamp,
+                   int *heap, int *pos)
+{
+  lt->deadline = deadline;
+  lt->stamp = stamp;
+  lt->heap = heap;
+  lt->pos = pos;
+}
+
+/* does timer a expire before timer b */
+static int before(const struct ltimers *lt, int a, int b)
+{
+  if (lt->deadline[a] != lt->deadline[b])
+    return lt->deadline[a] < lt->deadline[b];
+  return lt->stamp[a] < lt->stamp[b];
+}
+
+static void place(struct ltimers *lt, int i, int id)
+{
+  lt->heap[i] = id;
+  lt->pos[id] = i;
+}
+
+static void siftup(struct ltimers *lt, int i, int id)
+{
+  int parent;
+
+  while (i > 0) {
+    parent = (i - 1) / 2;
+    if (!before(lt, id, lt->heap[parent]))
+      break;
+    place(lt, i, lt->heap[parent]);
+    i = parent;
+  }
+  place(lt, i, id);
+}
+
+static void siftdown(struct ltimers *lt, int i, int id)
+{
+  int child;
+
+  while ((child = 2 * i + 1) < lt->count) {
+    if (child + 1 < lt->count && before(lt, lt->heap[child + 1], lt->heap[child]))
+      child++;
+    if (!before(lt, lt->heap[child], id))
+      break;
+    place(lt, i, lt->heap[child]);
+    i = child;
+  }
+  place(lt, i, id);
+}
+
+/* take timer id out of the heap */
+static void removetimer(struct ltimers *lt, int id)
+{
+  int i = lt->pos[id];
+  int last;
+
+  lt->pos[id] = -1;
+  last = lt->heap[--lt->count];
+  if (last == id)
+    return;
+  if (i > 0 && before(lt, last, lt->heap[(i - 1) / 2]))
+    siftup(lt, i, last);
+  else
+    siftdown(lt, i, last);
+}
+
+/* point the physical timer at the earliest deadline */
+static void rearm(struct simulation *sim, struct ltimers *lt)
+{
+  double increment;
+  float first;
+
+  if (lt->firing)
+    return;             /* ltimer_expired() rearms once it is done */
+  if (lt->count == 0) {
+    if (lt->running)
+      stoptimer(sim, lt->entity);
+    lt->running = 0;
+    return;
+  }
+  first = lt->deadline[lt->heap[0]];
+  if (lt->running && lt->armed == first)
+    return;
+  if (lt->running)
+    stoptimer(sim, lt->entity);
+  /* exact in double, so the timer event lands on first itself */
+  increment = (double)first - sim->time;
+  if (increment < 0)
+    increment = 0;
+  starttimer(sim, lt->entity, increment);
+  lt->running = 1;
+  lt->armed = first;
+}
+
+void ltimer_start(struct simulation *sim, struct ltimers *lt, int id, double increment)
+{
+  if (lt->pos[id] >= 0)
+    removetimer(lt, id);
+  /* rounded to float exactly as the emulator rounds event times */
+  lt->deadline[id] = sim->time + increment;
+  lt->stamp[id] = lt->nextstamp++;
+  siftup(lt, lt->count++, id);
+  rearm(sim, lt);
+}
+
+void ltimer_stop(struct simulation *sim, struct ltimers *lt, int id)
+{
+  if (lt->pos[id] < 0)
+    return;
+  removetimer(lt, id);
+  rearm(sim, lt);
+}
+
+int ltimer_expired(struct simulation *sim, struct ltimers *lt)
+{
+  int id;
+
+  if (!lt->firing) {      /* first call since the physical timer went off */
+    lt->firing = 1;
+    lt->running = 0;
+  }
+  if (lt->count > 0 && lt->deadline[lt->heap[0]] <= sim->time) {
+    id = lt->heap[0];
+    removetimer(lt, id);
+    return id;
+  }
+  lt->firing = 0;
+  rearm(sim, lt);
+  return -1;
+}
@@ -0,0 +1,61 @@
+#ifndef LTIMER_H
+#define LTIMER_H
+
+#include "emulator.h"
+
+/* ******************************************************************
+   Logical timers.
+
+   The emulator gives every entity a single timer.  A set of logical
+   timers, numbered 0..n-1, shares that physical timer: the deadlines
+   are kept in a min-heap and the physical timer is always armed for
+   the earliest one.  A protocol that uses logical timers must leave
+   the entity's physical timer to them, and must drain the expired
+   ones from its timer interrupt routine:
+
+       while ((id = ltimer_expired(sim, &timers)) >= 0)
+         ... handle the expiry of timer id ...
+
+   Timers with the same deadline expire in the order they were started.
+   The arrays are supplied by the caller so they can live in the
+   protocol's own state block.
+**********************************************************************/
+
+struct ltimers {
+  int entity;               /* A or B, whose physical timer is used */
+  int n;                    /* number of logical timers */
+  float *deadline;          /* [n] expiry time of each running timer */
+  unsigned long *stamp;     /* [n] start order, breaks deadline ties */
+  int *heap;                /* [n] running timers, earliest first */
+  int *pos;                 /* [n] index of each timer in heap, -1 if stopped */
+  int count;                /* number of running timers */
+  unsigned long nextstamp;
+  float armed;              /* deadline the physical timer is set for */
+  int running;              /* the physical timer is running */
+  int firing;               /* inside the expiry loop, leave the physical timer alone */
+};
+
+/* set up n stopped timers of entity in the arrays given, each of n elements */
+extern void ltimer_init(struct ltimers *lt, int entity, int n, float *deadline,
+                        unsigned long *stamp, int *heap, int *pos);
+
+/* point lt at its arrays again, which moved with the state block */
+/* holding them (a restored checkpoint); the timers are kept as they are */
+extern void ltimer_relink(struct ltimers *lt, float *deadline, unsigned long *stamp,
+                          int *heap, int *pos);
+
+/* (re)start timer id to expire increment time units from now */
+extern void ltimer_start(struct simulation *sim, struct ltimers *lt, int id, double increment);
+
+/* stop timer id; stopping a timer that is not running does nothing */
+extern void ltimer_stop(struct simulation *sim, struct ltimers *lt, int id);
+
+/* true if timer id is running */
+#define ltimer_running(lt, id) ((lt)->pos[id] >= 0)
+
+/* call from the entity's timer interrupt routine until it returns -1.  */
+/* returns the next expired timer, which is stopped first, or -1 once   */
+/* none is left, after rearming the physical timer for the next deadline */
+extern int ltimer_expired(struct simulation *sim, struct ltimers *lt);
+
+#endif
@@ -0,0 +1,427 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <ctype.h>
+#include "params.h"
+#include "rng.h"
+#include "protocol.h"
+#include "checksum.h"
+#include "cc.h"
+#include "channel.h"
+
+/* ******************************************************************
+   Parsing of simulation parameters from flags and config files.
+
+   Each parameter is described once in the table below, by name, short
+   flag, type and offset into struct sim_params, so adding a parameter
+   only needs a new field and a new table entry.
+**********************************************************************/
+
+#define P_INT     0   /* int */
+#define P_FLOAT   1   /* float */
+#define P_ULONG   2   /* unsigned long */
+#define P_BOOL    3   /* int, 0 or 1 (also accepts yes/no, on/off, true/false) */
+#define P_RNG     4   /* int, generator kind by name */
+#define P_PROTOCOL 5  /* const struct protocol *, by name */
+#define P_STRING  6   /* char[PARAM_STRLEN] */
+#define P_ACKMODE 7   /* int, acknowledgement mode by name */
+#define P_CHECKSUM 8  /* int, checksum kind by name */
+#define P_CONGESTION 9 /* int, congestion control kind by name */
+#define P_LOSSMODEL 10 /* int, channel loss model by name */
+#define P_DELAYMODEL 11 /* int, channel delay model by name */
+
+struct paramdef {
+  const char *name;   /* flag and config key */
+  char shortflag;     /* single letter flag, 0 if none */
+  int type;
+  size_t offset;      /* where the value lives in struct sim_params */
+  const char *help;
+};
+
+static const struct paramdef paramdefs[] = {
+  { "protocol",    'p', P_PROTOCOL, offsetof(struct sim_params, protocol),
+    "transport protocol: gbn or sr" },
+  { "window",      'w', P_INT,   offsetof(struct sim_params, windowsize),
+    "send window size (0: 6)" },
+  { "seqspace",    0,   P_INT,   offsetof(struct sim_params, seqspace),
+    "sequence space size (0: window + 1 for gbn, 2 * window for sr)" },
+  { "messages",    'n', P_INT,   offsetof(struct sim_params, nsimmax),
+    "number of messages to simulate" },
+  { "loss",        'l', P_FLOAT, offsetof(struct sim_params, lossprob),
+    "packet loss probability" },
+  { "corrupt",     'c', P_FLOAT, offsetof(struct sim_params, corruptprob),
+    "packet corruption probability" },
+  { "direction",   'd', P_INT,   offsetof(struct sim_params, corruptdirection),
+    "direction of loss/corruption: 0 A->B, 1 A<-B, 2 both" },
+  { "loss-model",  0,   P_LOSSMODEL, offsetof(struct sim_params, lossmodel),
+    "iid (each packet lost with probability loss) or gilbert (Gilbert-Elliott bursts)" },
+  { "ge-enter",    0,   P_FLOAT, offsetof(struct sim_params, geenter),
+    "gilbert: probability of going from the good to the bad state after a packet" },
+  { "ge-leave",    0,   P_FLOAT, offsetof(struct sim_params, geleave),
+    "gilbert: probability of going back to the good state after a packet" },
+  { "ge-loss",     0,   P_FLOAT, offsetof(struct sim_params, geloss),
+    "gilbert: loss probability in the bad state (loss applies in the good one)" },
+  { "delay-model", 0,   P_DELAYMODEL, offsetof(struct sim_params, delaymodel),
+    "uniform (1 to 10 time units, FIFO) or link (link-rate and prop-delay)" },
+  { "link-rate",   0,   P_FLOAT, offsetof(struct sim_params, linkrate),
+    "link: bytes sent per time unit, header included" },
+  { "prop-delay",  0,   P_FLOAT, offsetof(struct sim_params, propdelay),
+    "link: time from the end of sending a packet to its arrival" },
+  { "queue-limit", 0,   P_INT,   offsetof(struct sim_params, queuelimit),
+    "packets that can wait in a channel, the next one is dropped (0: no limit)" },
+  { "reorder",     0,   P_FLOAT, offsetof(struct sim_params, reorder),
+    "probability that a packet is held back and overtaken by those behind it" },
+  { "reorder-delay", 0, P_FLOAT, offsetof(struct sim_params, reorderdelay),
+    "longest time a reordered packet is held back" },
+  { "lambda",      'm', P_FLOAT, offsetof(struct sim_params, lambda),
+    "average time between messages from layer 5" },
+  { "burst",       0,   P_INT,   offsetof(struct sim_params, burst),
+    "messages given to the sender together at each layer 5 arrival" },
+  { "backlog",     0,   P_INT,   offsetof(struct sim_params, backlog),
+    "messages that can wait for a full send window (0: drop them, as before)" },
+  { "bidirectional", 0, P_BOOL,  offsetof(struct sim_params, bidirectional),
+    "send data both ways, A to B and B to A (0/1)" },
+  { "piggyback",   0,   P_BOOL,  offsetof(struct sim_params, piggyback),
+    "bidirectional: hold ACKs up to ack-delay for data to carry them (0/1)" },
+  { "flows",       0,   P_INT,   offsetof(struct sim_params, flows),
+    "number of A/B pairs, each with its own message arrivals (lambda apart)" },
+  { "bottleneck",  0,   P_BOOL,  offsetof(struct sim_params, bottleneck),
+    "the flows share one channel each way, queueing behind each other (0/1)" },
+  { "partitions",  0,   P_INT,   offsetof(struct sim_params, partitions),
+    "threads to simulate the flows on, each taking a share of them (same result)" },
+  { "payload",     0,   P_INT,   offsetof(struct sim_params, payload),
+    "message size in bytes, at most PAYLOAD_MAX (1500 by default)" },
+  { "trace",       't', P_INT,   offsetof(struct sim_params, trace),
+    "TRACE level" },
+  { "trace-file",  0,   P_STRING, offsetof(struct sim_params, tracefile),
+    "write trace output to this file instead of stdout" },
+  { "event-log",   0,   P_STRING, offsetof(struct sim_params, evlogfile),
+    "write a binary log of every event to this file (see evdecode)" },
+  { "stats-json",  0,   P_STRING, offsetof(struct sim_params, statsjson),
+    "also write the statistics as JSON to this file (- for stdout)" },
+  { "checkpoint",  0,   P_STRING, offsetof(struct sim_params, checkpoint),
+    "write checkpoints of the whole simulation to this file" },
+  { "checkpoint-at", 0, P_FLOAT, offsetof(struct sim_params, checkpointat),
+    "write a checkpoint once the simulated time reaches this (0: never)" },
+  { "checkpoint-every", 0, P_FLOAT, offsetof(struct sim_params, checkpointevery),
+    "write a checkpoint every so many time units, replacing the last (0: never)" },
+  { "restore",     0,   P_STRING, offsetof(struct sim_params, restore),
+    "carry on from this checkpoint; other flags override its parameters" },
+  { "seed",        's', P_ULONG, offsetof(struct sim_params, seed),
+    "random number generator seed" },
+  { "rng",         0,   P_RNG,   offsetof(struct sim_params, rngkind),
+    "generator: xoshiro256** or pcg32" },
+  { "rng-selftest", 0,  P_BOOL,  offsetof(struct sim_params, rngselftest),
+    "check the generators before the run (0/1)" },
+  { "adaptive-rto", 0,  P_BOOL,  offsetof(struct sim_params, adaptiverto),
+    "estimate the retransmission timeout from the RTT (0/1)" },
+  { "congestion",  0,   P_CONGESTION, offsetof(struct sim_params, congestion),
+    "sr congestion control: none (fixed window) or aimd (slow start, AIMD, fast retransmit)" },
+  { "ack-mode",    0,   P_ACKMODE, offsetof(struct sim_params, ackmode),
+    "acknowledgements: single (one per packet) or sack (cumulative + bitmap)" },
+  { "ack-every",   0,   P_INT,   offsetof(struct sim_params, ackevery),
+    "delayed ACKs: ACK every Nth in-order packet (1 ACKs them all at once)" },
+  { "ack-delay",   0,   P_FLOAT, offsetof(struct sim_params, ackdelay),
+    "delayed ACKs: longest time an in-order packet waits for its ACK" },
+  { "checksum",    0,   P_CHECKSUM, offsetof(struct sim_params, checksum),
+    "packet checksum: sum (the original), inet (16-bit ones' complement) or crc32c" },
+};
+
+#define NUM_PARAMS (int)(sizeof(paramdefs) / sizeof(paramdefs[0]))
+
+void params_default(struct sim_params *p)
+{
+  p->protocol = protocol_at(0);
+  p->windowsize = 0;
+  p->seqspace = 0;
+  p->nsimmax = 1000;
+  p->lossprob = 0.0;
+  p->corruptprob = 0.0;
+  p->corruptdirection = 2;
+  p->lossmodel = CHAN_LOSS_IID;
+  p->geenter = 0.01;
+  p->geleave = 0.2;
+  p->geloss = 1.0;
+  p->delaymodel = CHAN_DELAY_UNIFORM;
+  p->linkrate = 100.0;
+  p->propdelay = 1.0;
+  p->queuelimit = 0;
+  p->reorder = 0.0;
+  p->reorderdelay = 10.0;
+  p->lambda = 10.0;
+  p->burst = 1;
+  p->backlog = 0;
+  p->bidirectional = 0;
+  p->piggyback = 1;
+  p->flows = 1;
+  p->bottleneck = 0;
+  p->partitions = 1;
+  p->payload = 20;
+  p->trace = 0;
+  p->tracefile[0] = '\0';
+  p->evlogfile[0] = '\0';
+  p->statsjson[0] = '\0';
+  p->checkpoint[0] = '\0';
+  p->checkpointat = 0.0;
+  p->checkpointevery = 0.0;
+  p->restore[0] = '\0';
+  p->seed = 9999;
+  p->rngkind = RNG_XOSHIRO256SS;
+  p->rngselftest = 1;
+  p->adaptiverto = 0;
+  p->congestion = CC_NONE;
+  p->ackmode = ACK_SINGLE;
+  p->ackevery = 1;
+  p->ackdelay = 4.0;
+  p->checksum = CKSUM_SUM;
+}
+
+static const struct paramdef *findparam(const char *name, char shortflag)
+{
+  int i;
+
+  for (i = 0; i < NUM_PARAMS; i++)
+    if ((name != NULL && strcmp(paramdefs[i].name, name) == 0) ||
+        (name == NULL && shortflag != 0 && paramdefs[i].shortflag == shortflag))
+      return &paramdefs[i];
+  return NULL;
+}
+
+static int setparam(struct sim_params *p, const struct paramdef *d, const char *value)
+{
+  char *field = (char *)p + d->offset;
+  char *end;
+  long l;
+  unsigned long ul;
+  double f;
+  const struct protocol *proto;
+  int kind;
+
+  switch (d->type) {
+  case P_INT:
+    l = strtol(value, &end, 10);
+    if (end == value || *end != '\0')
+      break;
+    *(int *)field = (int)l;
+    return 0;
+  case P_FLOAT:
+    f = strtod(value, &end);
+    if (end == value || *end != '\0')
+      break;
+    *(float *)field = (float)f;
+    return 0;
+  case P_ULONG:
+    ul = strtoul(value, &end, 0);
+    if (end == value || *end != '\0')
+      break;
+    *(unsigned long *)field = ul;
+    return 0;
+  case P_BOOL:
+    if (strcmp(value, "1") == 0 || strcmp(value, "yes") == 0 ||
+        strcmp(value, "on") == 0 || strcmp(value, "true") == 0) {
+      *(int *)field = 1;
+      return 0;
+    }
+    if (strcmp(value, "0") == 0 || strcmp(value, "no") == 0 ||
+        strcmp(value, "off") == 0 || strcmp(value, "false") == 0) {
+      *(int *)field = 0;
+      return 0;
+    }
+    break;
+  case P_RNG:
+    if ((kind = rng_kindbyname(value)) < 0)
+      break;
+    *(int *)field = kind;
+    return 0;
+  case P_PROTOCOL:
+    if ((proto = protocol_find(value)) == NULL)
+      break;
+    *(const struct protocol **)field = proto;
+    return 0;
+  case P_ACKMODE:
+    if ((kind = ackmode_byname(value)) < 0)
+      break;
+    *(int *)field = kind;
+    return 0;
+  case P_CHECKSUM:
+    if ((kind = checksum_byname(value)) < 0)
+      break;
+    *(int *)field = kind;
+    return 0;
+  case P_CONGESTION:
+    if ((kind = cc_byname(value)) < 0)
+      break;
+    *(int *)field = kind;
+    return 0;
+  case P_LOSSMODEL:
+    if ((kind = chanloss_byname(value)) < 0)
+      break;
+    *(int *)field = kind;
+    return 0;
+  case P_DELAYMODEL:
+    if ((kind = chandelay_byname(value)) < 0)
+      break;
+    *(int *)field = kind;
+    return 0;
+  case P_STRING:
+    if (strlen(value) >= PARAM_STRLEN)
+      break;
+    strcpy(field, value);
+    return 0;
+  }
+  fprintf(stderr, "invalid value '%s' for parameter %s\n", value, d->name);
+  return -1;
+}
+
+int params_set(struct sim_params *p, const char *name, const char *value)
+{
+  const struct paramdef *d = findparam(name, 0);
+
+  if (d == NULL) {
+    fprintf(stderr, "unknown parameter '%s'\n", name);
+    return -1;
+  }
+  return setparam(p, d, value);
+}
+
+/* strip leading and trailing white space in place */
+static char *trim(char *s)
+{
+  char *end;
+
+  while (isspace((unsigned char)*s))
+    s++;
+  end = s + strlen(s);
+  while (end > s && isspace((unsigned char)end[-1]))
+    *--end = '\0';
+  return s;
+}
+
+int params_load(struct sim_params *p, const char *file)
+{
+  FILE *fp;
+  char line[512];
+  char *key, *value, *eq;
+  int lineno = 0;
+
+  if ((fp = fopen(file, "r")) == NULL) {
+    fprintf(stderr, "cannot open config file %s\n", file);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    lineno++;
+    if ((value = strchr(line, '#')) != NULL)
+      *value = '\0';
+    key = trim(line);
+    if (*key == '\0')
+      continue;
+    if ((eq = strchr(key, '=')) == NULL) {
+      fprintf(stderr, "%s:%d: expected key = value\n", file, lineno);
+      fclose(fp);
+      return -1;
+    }
+    *eq = '\0';
+    key = trim(key);
+    value = trim(eq + 1);
+    if (params_set(p, key, value) < 0) {
+      fprintf(stderr, "%s:%d: bad setting\n", file, lineno);
+      fclose(fp);
+      return -1;
+    }
+  }
+  fclose(fp);
+  return 0;
+}
+
+int params_parse_args(struct sim_params *p, int argc, char **argv)
+{
+  const struct paramdef *d;
+  char name[64];
+  const char *arg, *value, *eq;
+  int i, nset = 0;
+  size_t len;
+
+  for (i = 1; i < argc; i++) {
+    arg = argv[i];
+    if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0)
+      return -2;
+
+    value = NULL;
+    if (arg[0] == '-' && arg[1] == '-') {       /* --name or --name=value */
+      arg += 2;
+      eq = strchr(arg, '=');
+      len = eq ? (size_t)(eq - arg) : strlen(arg);
+      if (len >= sizeof(name))
+        len = sizeof(name) - 1;
+      memcpy(name, arg, len);
+      name[len] = '\0';
+      if (eq)
+        value = eq + 1;
+    }
+    else if (arg[0] == '-' && arg[1] != '\0' && arg[2] == '\0') {  /* -x */
+      if (arg[1] == 'f')
+        strcpy(name, "config");
+      else if ((d = findparam(NULL, arg[1])) != NULL)
+        strcpy(name, d->name);
+      else {
+        fprintf(stderr, "unknown flag %s\n", arg);
+        return -1;
+      }
+    }
+    else {
+      fprintf(stderr, "unexpected argument %s\n", arg);
+      return -1;
+    }
+
+    if (value == NULL) {          /* value is the next argument */
+      if (i + 1 >= argc) {
+        fprintf(stderr, "missing value for %s\n", argv[i]);
+        return -1;
+      }
+      value = argv[++i];
+    }
+
+    if (strcmp(name, "config") == 0) {
+      if (params_load(p, value) < 0)
+        return -1;
+    }
+    else if (params_set(p, name, value) < 0)
+      return -1;
+    nset++;
+  }
+  return nset;
+}
+
+void params_prompt(struct sim_params *p)
+{
+  printf("Enter the number of messages to simulate: ");
+  scanf("%d",&p->nsimmax);
+  printf("Enter  packet loss probability [enter 0.0 for no loss]:");
+  scanf("%f",&p->lossprob);
+  printf("Enter packet corruption probability [0.0 for no corruption]:");
+  scanf("%f",&p->corruptprob);
+  if (p->lossprob != 0.0 || p->corruptprob != 0.0) {
+    printf("If you want loss or corruption to only occur in one direction, choose the direction: 0 A->B, 1 A<-B, 2 A<->B (both directions) :");
+    scanf("%d",&p->corruptdirection);
+  }
+  printf("Enter average time between messages from sender's layer5 [ > 0.0]:");
+  scanf("%f",&p->lambda);
+  printf("Enter TRACE:");
+  scanf("%d",&p->trace);
+}
+
+void params_usage(const char *prog)
+{
+  int i;
+
+  printf("usage: %s [--name=value | -x value]... [--config FILE | -f FILE]\n", prog);
+  printf("with no arguments the parameters are read interactively.\n");
+  printf("config files hold one \"name = value\" per line, '#' starts a comment.\n\n");
+  for (i = 0; i < NUM_PARAMS; i++) {
+    if (paramdefs[i].shortflag)
+      printf("  -%c, --%-14s %s\n", paramdefs[i].shortflag, paramdefs[i].name, paramdefs[i].help);
+    else
+      printf("      --%-14s %s\n", paramdefs[i].name, paramdefs[i].help);
+  }
+}
@@ -0,0 +1,87 @@
+#ifndef PARAMS_H
+#define PARAMS_H
+
+/* ******************************************************************
+   Simulation parameters.
+
+   A run is described by a struct sim_params.  It can be filled in from
+   command-line flags, from config files of "key = value" lines, or by
+   the interactive prompts of the original emulator.  Every parameter
+   has the same name as a flag (--name=value) and as a config key.
+**********************************************************************/
+
+#define PARAM_STRLEN 256   /* size of string parameters */
+
+struct protocol;
+
+struct sim_params {
+  const struct protocol *protocol;  /* transport protocol under test, see protocol.h */
+  int windowsize;         /* send window, 0 for the protocol's default */
+  int seqspace;           /* sequence numbers, 0 for the protocol's default */
+  int nsimmax;            /* number of msgs to generate, then stop */
+  float lossprob;         /* probability that a packet is dropped */
+  float corruptprob;      /* probability that one bit is packet is flipped */
+  int corruptdirection;   /* A->B A<-B or bidirectional corruption/loss */
+  int lossmodel;          /* CHAN_LOSS_ kind, see channel.h */
+  float geenter, geleave; /* Gilbert-Elliott: per packet probabilities of entering */
+                          /* and leaving the bad state */
+  float geloss;           /* ... and of loss in it */
+  int delaymodel;         /* CHAN_DELAY_ kind */
+  float linkrate;         /* link: bytes per time unit */
+  float propdelay;        /* link: propagation delay */
+  int queuelimit;         /* packets a channel holds, 0 for no limit */
+  float reorder;          /* probability that a packet is held back ... */
+  float reorderdelay;     /* ... by up to this long */
+  float lambda;           /* arrival rate of messages from layer 5 */
+  int burst;              /* messages handed to layer 4 at each arrival */
+  int backlog;            /* messages that wait for a full window, 0 to drop them */
+  int bidirectional;      /* messages arrive at B too, to be sent to A */
+  int piggyback;          /* bidirectional: ACKs wait for data to carry them */
+  int flows;              /* A/B pairs, each with its own arrivals and protocol state */
+  int bottleneck;         /* the flows share one channel each way instead of one each */
+  int partitions;         /* threads the flows are split over, see pdes.h */
+  int payload;            /* bytes in each message, at most PAYLOAD_MAX */
+  int trace;              /* TRACE level, see trace.h */
+  char tracefile[PARAM_STRLEN]; /* file for trace output, "" for stdout */
+  char evlogfile[PARAM_STRLEN]; /* binary event log, "" for none, see evlog.h */
+  char statsjson[PARAM_STRLEN]; /* statistics as JSON, "" for none, "-" for stdout */
+  char checkpoint[PARAM_STRLEN]; /* checkpoint file, "" for none, see checkpoint.h */
+  float checkpointat;     /* write it once the simulated time gets here, 0 for never */
+  float checkpointevery;  /* ... and/or every so many time units, 0 for never */
+  char restore[PARAM_STRLEN];   /* carry on from this checkpoint, "" to start afresh */
+  unsigned long seed;     /* seed of the random number generators */
+  int rngkind;            /* generator algorithm, see rng.h */
+  int rngselftest;        /* sanity check the generators before the run */
+  int adaptiverto;        /* adaptive retransmission timeout instead of RTT, see rto.h */
+  int congestion;         /* CC_ kind of the sender's congestion control, see cc.h */
+  int ackmode;            /* ACK_SINGLE or ACK_SACK, see protocol.h */
+  int checksum;           /* CKSUM_ kind, see checksum.h */
+  int ackevery;           /* receiver ACKs every ackevery'th in-order packet */
+  float ackdelay;         /* ... or this long after the first one it has not ACKed */
+};
+
+/* fill p with the default value of every parameter */
+extern void params_default(struct sim_params *p);
+
+/* set parameter name from its text value.  returns 0 on success, -1 */
+/* (after printing why) if the name is unknown or the value is invalid */
+extern int params_set(struct sim_params *p, const char *name, const char *value);
+
+/* read "key = value" lines from file; '#' starts a comment. */
+/* returns 0 on success, -1 on the first error */
+extern int params_load(struct sim_params *p, const char *file);
+
+/* apply command-line arguments: --name=value, --name value, the short */
+/* flags listed by params_usage(), and --config FILE (or -f FILE) which */
+/* loads a config file at that point.  later settings override earlier */
+/* ones.  returns the number of parameters set, -1 on error and -2 if */
+/* --help was given */
+extern int params_parse_args(struct sim_params *p, int argc, char **argv);
+
+/* ask for the parameters interactively on stdin, as the original emulator did */
+extern void params_prompt(struct sim_params *p);
+
+/* print the accepted flags and config keys */
+extern void params_usage(const char *prog);
+
+#endif
@@ -0,0 +1,119 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <pthread.h>
+#include "pdes.h"
+
+struct pdes {
+  struct simulation *sim;
+  struct simulation **parts;
+  int nparts;
+  float end;                /* of the current window */
+  int done;
+  pthread_mutex_t lock;     /* protects the rest */
+  pthread_cond_t cond;
+  int waiting;              /* partitions at the end of the window */
+  unsigned long window;     /* windows started so far */
+};
+
+struct worker {
+  struct pdes *pd;
+  struct simulation *part;
+  pthread_t thread;
+};
+
+/* schedule what the last window sent and pick the next one; called */
+/* with every partition waiting */
+static void plan(struct pdes *pd)
+{
+  float t, next;
+  int k;
+
+  for (;;) {
+    sim_schedule(pd->parts, pd->nparts);
+    next = HUGE_VALF;
+    for (k = 0; k < pd->nparts; k++)
+      if ((t = sim_nexttime(pd->parts[k])) < next)
+        next = t;
+    if (next == HUGE_VALF) {
+      pd->done = 1;
+      return;
+    }
+    pd->end = sim_lookahead(pd->sim, next);
+    if (pd->end > next)
+      return;
+    /* no lookahead left (a link without propagation delay, or one too */
+    /* short to show at this time): take the next event on its own     */
+    sim_stepfirst(pd->parts, pd->nparts);
+  }
+}
+
+/* wait for every partition to finish the window; the last one to */
+/* arrive plans the next */
+static void endwindow(struct pdes *pd)
+{
+  unsigned long window;
+
+  pthread_mutex_lock(&pd->lock);
+  window = pd->window;
+  if (++pd->waiting == pd->nparts) {
+    plan(pd);
+    pd->waiting = 0;
+    pd->window++;
+    pthread_cond_broadcast(&pd->cond);
+  }
+  else
+    while (pd->window == window)
+      pthread_cond_wait(&pd->cond, &pd->lock);
+  pthread_mutex_unlock(&pd->lock);
+}
+
+static void *workermain(void *arg)
+{
+  struct worker *w = arg;
+
+  for (;;) {
+    endwindow(w->pd);
+    if (w->pd->done)
+      break;
+    sim_rununtil(w->part, w->pd->end);
+  }
+  return NULL;
+}
+
+void pdes_run(struct simulation *sim)
+{
+  struct worker *workers;
+  struct pdes pd;
+  int k;
+
+  pd.sim = sim;
+  pd.nparts = sim->params.partitions;
+  if (pd.nparts > sim->params.flows)
+    pd.nparts = sim->params.flows;
+  pd.parts = sim_split(sim, pd.nparts);
+  pd.end = 0.0;
+  pd.done = 0;
+  pd.waiting = 0;
+  pd.window = 0;
+  pthread_mutex_init(&pd.lock, NULL);
+  pthread_cond_init(&pd.cond, NULL);
+
+  workers = malloc(pd.nparts * sizeof(struct worker));
+  if (workers == 0) {
+    printf("memory allocation for partitions failed.");
+    exit(EXIT_FAILURE);
+  }
+  for (k = 0; k < pd.nparts; k++) {
+    workers[k].pd = &pd;
+    workers[k].part = pd.parts[k];
+    pthread_create(&workers[k].thread, NULL, workermain, &workers[k]);
+  }
+  for (k = 0; k < pd.nparts; k++)
+    pthread_join(workers[k].thread, NULL);
+
+  sim_join(sim, pd.parts, pd.nparts);
+  free(workers);
+  pthread_cond_destroy(&pd.cond);
+  pthread_mutex_destroy(&pd.lock);
+}
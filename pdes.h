@@ -0,0 +1,39 @@
+#ifndef PDES_H
+#define PDES_H
+
+#include "emulator.h"
+
+/* ******************************************************************
+   Conservative parallel simulation of the flows of one run.
+
+   The flows are split into params.partitions partitions of
+   consecutive flows, each simulated by a thread of its own with its
+   own event list (see sim_split() in emulator.h).  Every flow has its
+   own protocol state, random streams and message quota, and ties
+   between events of the same time are broken flow by flow, so a
+   partition takes each of its flows through exactly the events the
+   single event loop would, and the run ends with the same statistics
+   to the bit.
+
+   Without a bottleneck no packet ever leaves its flow, and the
+   partitions run to the end independently.  With one, packets of
+   every flow queue on the same channel, and the partitions advance in
+   windows: all of them simulate the events before the end of the
+   window, then wait for each other while the packets sent in the
+   window are scheduled on the channel in the order a single event
+   loop would have sent them.  A packet arrives at least 1 time unit
+   after it was sent, and after the last one on its channel, so the
+   window ends that long after its start or the last arrival; nothing sent
+   inside a window can arrive within it.  With the link model the least
+   delay is the propagation delay and the time to send a bare header
+   (see channel.h); should that round away to nothing, the partitions
+   take the events one at a time, in order, until it reappears.
+**********************************************************************/
+
+#define PDES_MAXPARTS  256
+
+/* run sim on min(params.partitions, params.flows) threads until no */
+/* events are left; called by sim_run() */
+extern void pdes_run(struct simulation *sim);
+
+#endif
@@ -0,0 +1,119 @@
+#include <string.h>
+#include <limits.h>
+#include "protocol.h"
+#include "gbn.h"
+#include "sr.h"
+#include "bitset.h"
+#include "checksum.h"
+
+/* every protocol that can be selected at run time, default first */
+static const struct protocol *const registry[] = {
+  &gbn_protocol,
+  &sr_protocol,
+  NULL
+};
+
+const struct protocol *protocol_find(const char *name)
+{
+  int i;
+
+  for (i = 0; registry[i] != NULL; i++)
+    if (strcmp(registry[i]->name, name) == 0)
+      return registry[i];
+  return NULL;
+}
+
+const struct protocol *protocol_at(int i)
+{
+  if (i < 0 || i >= (int)(sizeof(registry) / sizeof(registry[0])))
+    return NULL;
+  return registry[i];
+}
+
+int ComputeChecksum(const struct simulation *sim, const struct pkt *packet)
+{
+  return (int)checksum_compute(sim->params.checksum, packet);
+}
+
+bool IsCorrupted(const struct simulation *sim, const struct pkt *packet)
+{
+  if (packet->checksum == ComputeChecksum(sim, packet))
+    return (false);
+  else
+    return (true);
+}
+
+bool ack_due(const struct simulation *sim, int unacked)
+{
+  /* waiting for data, unless ack-every caps the wait */
+  if (sim->params.bidirectional && sim->params.piggyback)
+    return sim->params.ackevery > 1 && unacked >= sim->params.ackevery;
+  return unacked >= sim->params.ackevery;
+}
+
+static const char *const acknames[] = { "single", "sack" };
+
+int ackmode_byname(const char *name)
+{
+  int i;
+
+  for (i = 0; i < (int)(sizeof(acknames) / sizeof(acknames[0])); i++)
+    if (strcmp(acknames[i], name) == 0)
+      return i;
+  return -1;
+}
+
+const char *ackmode_name(int mode)
+{
+  if (mode < 0 || mode >= (int)(sizeof(acknames) / sizeof(acknames[0])))
+    return "?";
+  return acknames[mode];
+}
+
+int seq_default(int n)
+{
+#ifdef SEQ_POW2_ONLY
+  int size;
+
+  for (size = 1; size < n && size <= INT_MAX / 2; size *= 2)
+    ;
+  return size;      /* too small for n only if no int is large enough */
+#else
+  return n;
+#endif
+}
+
+int pkt_room(const struct sim_params *params)
+{
+  int room = params->payload > ACKLEN ? params->payload : ACKLEN;
+
+  if (params->ackmode == ACK_SACK && (params->windowsize + 7) / 8 > room)
+    room = (params->windowsize + 7) / 8;
+  return room;
+}
+
+/* slots keep the alignment of whatever follows them */
+#define STRIDE(n)  (((n) + 7) / 8 * 8)
+
+size_t msg_stride(const struct sim_params *params)
+{
+  return STRIDE(offsetof(struct msg, data) + params->payload);
+}
+
+size_t pkt_stride(const struct sim_params *params)
+{
+  return STRIDE(offsetof(struct pkt, payload) + pkt_room(params));
+}
+
+void sack_encode(struct pkt *p, const uint64_t *have, int first, int n, int seqspace)
+{
+  int i, bit;
+
+  p->length = (n + 7) / 8;
+  memset(p->payload, 0, p->length);
+  for (i = 0; i < n; i++) {
+    bit = first + i < seqspace ? first + i : first + i - seqspace;
+    if (bitset_test(have, bit))
+      p->payload[i / 8] |= (char)(1 << (i % 8));
+  }
+}
@@ -0,0 +1,117 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "emulator.h"
+
+/* ******************************************************************
+   Protocol registry.
+
+   Each transport protocol (gbn.c, sr.c, ...) exports one struct
+   protocol holding its entry points.  The emulator calls the protocol
+   chosen by the "protocol" parameter through this table, so every
+   protocol is linked into the same binary and can be compared on the
+   same random number streams.  A new protocol needs a struct protocol
+   of its own and an entry in the registry in protocol.c.
+**********************************************************************/
+
+struct protocol {
+  const char *name;                       /* value of the protocol parameter */
+  const char *description;
+
+  /* called before the simulation starts: fill in the protocol's own */
+  /* defaults of parameters left at 0 and check that the parameters */
+  /* can work.  returns 0, or -1 after printing why not */
+  int (*configure)(struct sim_params *params);
+
+  /* every routine below is passed the entity it runs for: A or B, or */
+  /* with --flows either side of any flow (see entity_of() in emulator.h) */
+
+  /* called once (only) before any other routine of the entity; sets */
+  /* up the entity's part of the state block in sim->state */
+  void (*init)(struct simulation *sim, int entity);
+
+  /* called from layer 5, passed the n messages to be sent to the other */
+  /* side, in order.  returns how many of them, from the first on, were */
+  /* accepted; the emulator counts the rest as dropped (window_full) */
+  int (*output)(struct simulation *sim, int entity, const struct msg *msgs, int n);
+
+  /* called from layer 3, when a packet arrives for layer 4.  packet */
+  /* points into the event that carried it and is only valid during */
+  /* the call; copy what must be kept */
+  void (*input)(struct simulation *sim, int entity, const struct pkt *packet);
+
+  /* called when the entity's timer goes off */
+  void (*timerinterrupt)(struct simulation *sim, int entity);
+
+  /* the state of every entity is one block, laid out field by field */
+  /* with an element per entity rather than entity by entity.  the   */
+  /* emulator allocates statesize bytes for params in sim->state, and */
+  /* relink points the pointers in the block at its own arrays: when */
+  /* it is new, and again after a checkpoint (see checkpoint.h) was  */
+  /* restored into it */
+  size_t (*statesize)(const struct sim_params *params);
+  void (*relink)(struct simulation *sim);
+};
+
+/* the registered protocol called name, NULL if there is none */
+extern const struct protocol *protocol_find(const char *name);
+
+/* the i'th registered protocol, NULL once i is past the last one */
+extern const struct protocol *protocol_at(int i);
+
+/* generic procedure to compute the checksum of a packet.  Used by both sender and receiver
+   the simulator will overwrite part of your packet with 'z's.  It will not overwrite your
+   original checksum.  This procedure must generate a different checksum to the original if
+   the packet is corrupted.
+*/
+/* checksum of packet, of the kind the "checksum" parameter selects */
+extern int ComputeChecksum(const struct simulation *sim, const struct pkt *packet);
+extern bool IsCorrupted(const struct simulation *sim, const struct pkt *packet);
+
+/* true if the ACK of the unacked in-order packets a receiver holds */
+/* should be sent now.  otherwise it waits for the ACK timer (delayed */
+/* ACKs, --ack-every and --ack-delay), or for data going the other way */
+/* to carry it (--bidirectional with --piggyback) */
+extern bool ack_due(const struct simulation *sim, int unacked);
+
+/* payload bytes of an ACK that carries no data or SACK bitmap, all '0' */
+#define ACKLEN  20
+
+/* acknowledgement modes, the "ack-mode" parameter */
+#define ACK_SINGLE  0   /* one ACK per data packet, acknum is the packet's seqnum */
+#define ACK_SACK    1   /* acknum is cumulative, the payload a bitmap of later */
+                        /* packets the receiver holds out of order */
+
+/* the ACK_ mode called name, -1 if there is none */
+extern int ackmode_byname(const char *name);
+extern const char *ackmode_name(int mode);
+
+/* a SACK bitmap is the payload: bit i stands for seqnum acknum + 1 + i */
+#define SACK_MAXBITS  (8 * (int)sizeof(((struct pkt *)0)->payload))
+
+/* write the n bits first, first + 1, ... (modulo seqspace) of the */
+/* bitset have into the payload of ACK packet p, n <= SACK_MAXBITS. */
+/* the payload is made just long enough to hold them */
+extern void sack_encode(struct pkt *p, const uint64_t *have, int first, int n, int seqspace);
+
+/* the sequence space a protocol defaults to when it needs n numbers: */
+/* n, or the next power of two in a -DSEQ_POW2_ONLY build, which only */
+/* handles those (see seq.h) */
+extern int seq_default(int n);
+
+/* the most payload bytes a packet of a run with params carries: a */
+/* message, a plain ACK or a SACK bitmap of the window */
+extern int pkt_room(const struct sim_params *params);
+
+/* bytes between the elements of an array of messages, and of packets, */
+/* for a run with params (see msg_at() in emulator.h).  the protocol's */
+/* configure must have filled in its defaults */
+extern size_t msg_stride(const struct sim_params *params);
+extern size_t pkt_stride(const struct sim_params *params);
+
+/* bit i of the SACK bitmap in p */
+#define sack_isset(p, i) (((unsigned char)(p)->payload[(i) / 8] >> ((i) % 8)) & 1)
+
+#endif
@@ -0,0 +1,151 @@
+#include <string.h>
+#include "rng.h"
+
+/* ******************************************************************
+   Pseudo random number generators.
+
+   xoshiro256** and its jump polynomial are by D. Blackman and
+   S. Vigna, PCG-XSH-RR by M. O'Neill.  Both are seeded through
+   splitmix64 so that any 64 bit seed gives a well mixed state.
+**********************************************************************/
+
+static uint64_t splitmix64(uint64_t *x)
+{
+  uint64_t z;
+
+  z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static uint64_t rotl(uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t xoshiro_next(uint64_t *s)
+{
+  uint64_t result, t;
+
+  result = rotl(s[1] * 5, 7) * 9;
+  t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+  return result;
+}
+
+/* advance the state by 2^128 draws, giving a non-overlapping stream */
+static void xoshiro_jump(uint64_t *s)
+{
+  static const uint64_t JUMP[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                   0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+  uint64_t t[4] = { 0, 0, 0, 0 };
+  int i, b;
+
+  for (i = 0; i < 4; i++)
+    for (b = 0; b < 64; b++) {
+      if (JUMP[i] & ((uint64_t)1 << b)) {
+        t[0] ^= s[0];
+        t[1] ^= s[1];
+        t[2] ^= s[2];
+        t[3] ^= s[3];
+      }
+      xoshiro_next(s);
+    }
+  memcpy(s, t, sizeof(t));
+}
+
+static uint32_t pcg32_next(uint64_t *s)
+{
+  uint64_t old;
+  uint32_t xorshifted, rot;
+
+  old = s[0];
+  s[0] = old * 6364136223846793005ULL + s[1];
+  xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+  rot = (uint32_t)(old >> 59);
+  return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+void rng_seed(struct rng *r, int kind, uint64_t seed, int stream)
+{
+  uint64_t x = seed;
+  int i;
+
+  r->kind = kind;
+  if (kind == RNG_PCG32) {
+    /* PCG selects independent streams through the increment */
+    r->s[0] = splitmix64(&x);
+    r->s[1] = ((uint64_t)stream << 1) | 1;
+    r->s[2] = r->s[3] = 0;
+    pcg32_next(r->s);
+  }
+  else {
+    r->kind = RNG_XOSHIRO256SS;
+    for (i = 0; i < 4; i++)
+      r->s[i] = splitmix64(&x);
+    for (i = 0; i < stream; i++)
+      xoshiro_jump(r->s);
+  }
+}
+
+void rng_seed_streams(struct rng *r, int n, int kind, uint64_t seed)
+{
+  int i;
+
+  if (kind == RNG_PCG32) {
+    for (i = 0; i < n; i++)
+      rng_seed(&r[i], kind, seed, i);
+    return;
+  }
+  rng_seed(&r[0], kind, seed, 0);
+  for (i = 1; i < n; i++) {   /* one jump on from the stream before */
+    r[i] = r[i - 1];
+    xoshiro_jump(r[i].s);
+  }
+}
+
+uint32_t rng_next32(struct rng *r)
+{
+  if (r->kind == RNG_PCG32)
+    return pcg32_next(r->s);
+  return (uint32_t)(xoshiro_next(r->s) >> 32);
+}
+
+double rng_uniform(struct rng *r)
+{
+  if (r->kind == RNG_PCG32)
+    return pcg32_next(r->s) * (1.0 / 4294967296.0);
+  return (xoshiro_next(r->s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+int rng_selftest(const struct rng *r, int n)
+{
+  struct rng copy = *r;
+  double sum = 0.0, avg;
+  int i;
+
+  for (i = 0; i < n; i++)
+    sum += rng_uniform(&copy);    /* should be uniform in [0,1) */
+  avg = sum / n;
+  return (avg >= 0.25 && avg <= 0.75);
+}
+
+const char *rng_kindname(int kind)
+{
+  return (kind == RNG_PCG32) ? "pcg32" : "xoshiro256**";
+}
+
+int rng_kindbyname(const char *name)
+{
+  if (strcmp(name, "xoshiro256**") == 0 || strcmp(name, "xoshiro") == 0)
+    return RNG_XOSHIRO256SS;
+  if (strcmp(name, "pcg32") == 0 || strcmp(name, "pcg") == 0)
+    return RNG_PCG32;
+  return -1;
+}
@@ -0,0 +1,45 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/* ******************************************************************
+   Seedable pseudo random number generators for the emulator.
+
+   Every random draw in a simulation comes from a struct rng, so two
+   simulations with their own generators never share state.  The
+   generator algorithm is chosen when the generator is seeded.
+**********************************************************************/
+
+/* generator algorithms */
+#define RNG_XOSHIRO256SS 0   /* xoshiro256** (default) */
+#define RNG_PCG32        1   /* PCG-XSH-RR 64/32 */
+
+struct rng {
+  int kind;         /* RNG_XOSHIRO256SS or RNG_PCG32 */
+  uint64_t s[4];    /* generator state; PCG32 uses s[0] (state), s[1] (increment) */
+};
+
+/* seed generator r; stream selects one of many independent sequences */
+/* that can be derived from the same seed */
+extern void rng_seed(struct rng *r, int kind, uint64_t seed, int stream);
+
+/* seed r[0] .. r[n - 1] as streams 0 .. n - 1 of seed, the same as */
+/* rng_seed() would one by one but in time linear in n */
+extern void rng_seed_streams(struct rng *r, int n, int kind, uint64_t seed);
+
+/* next raw 32 random bits */
+extern uint32_t rng_next32(struct rng *r);
+
+/* a double uniform in [0,1) */
+extern double rng_uniform(struct rng *r);
+
+/* draw n samples from a copy of r and check that their mean is close to 0.5. */
+/* r itself is left untouched.  returns 1 if the generator looks sane. */
+extern int rng_selftest(const struct rng *r, int n);
+
+/* name of a generator kind, and the reverse lookup (-1 if unknown) */
+extern const char *rng_kindname(int kind);
+extern int rng_kindbyname(const char *name);
+
+#endif
@@ -0,0 +1,56 @@
+#include "rto.h"
+
+#define RTO_ALPHA  0.125    /* gain of srtt */
+#define RTO_BETA   0.25     /* gain of rttvar */
+#define RTO_K      4.0      /* weight of rttvar in the timeout */
+
+static double clamp(double t)
+{
+  if (t < RTO_MIN)
+    return RTO_MIN;
+  if (t > RTO_MAX)
+    return RTO_MAX;
+  return t;
+}
+
+void rto_init(struct rto *r, int adaptive, double initial)
+{
+  r->adaptive = adaptive;
+  r->srtt = 0.0;
+  r->rttvar = 0.0;
+  r->base = initial;
+  r->timeout = initial;
+  r->nsamples = 0;
+}
+
+void rto_sample(struct rto *r, double rtt)
+{
+  double err;
+
+  if (!r->adaptive)
+    return;
+  if (r->nsamples++ == 0) {
+    r->srtt = rtt;
+    r->rttvar = rtt / 2;
+  }
+  else {
+    err = rtt - r->srtt;
+    if (err < 0)
+      err = -err;
+    r->rttvar += RTO_BETA * (err - r->rttvar);   /* before srtt moves */
+    r->srtt += RTO_ALPHA * (rtt - r->srtt);
+  }
+  r->base = clamp(r->srtt + RTO_K * r->rttvar);
+  r->timeout = r->base;
+}
+
+void rto_ack(struct rto *r)
+{
+  r->timeout = r->base;
+}
+
+void rto_backoff(struct rto *r)
+{
+  if (r->adaptive)
+    r->timeout = clamp(2 * r->timeout);
+}
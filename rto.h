@@ -0,0 +1,45 @@
+#ifndef RTO_H
+#define RTO_H
+
+/* ******************************************************************
+   Retransmission timeout.
+
+   In fixed mode the timeout is always the initial value, as the
+   assignment requires.  In adaptive mode it follows the smoothed
+   round trip time and its variation (Jacobson/Karels, as in RFC 6298),
+   doubles on every timeout, and is clamped to [RTO_MIN, RTO_MAX].
+   The sender only feeds it samples of packets that were sent once
+   (Karn's rule), since the ACK of a resent packet may belong to any
+   of its copies.  The backoff is undone as soon as new data is ACKed,
+   sample or not, so a run of losses does not leave the sender waiting
+   on a huge timeout until it next gets a clean sample.
+**********************************************************************/
+
+#define RTO_MIN   1.0       /* the channel delay is at least 1 each way */
+#define RTO_MAX   1000.0
+
+struct rto {
+  int adaptive;             /* 0 for a fixed timeout */
+  double srtt;              /* smoothed round trip time */
+  double rttvar;            /* round trip time variation */
+  double base;              /* timeout before backoff */
+  double timeout;           /* current timeout, backoff included */
+  int nsamples;             /* samples taken so far */
+};
+
+/* start with timeout initial, which is also the fixed timeout */
+extern void rto_init(struct rto *r, int adaptive, double initial);
+
+/* a packet sent once was ACKed rtt time units after it was sent */
+extern void rto_sample(struct rto *r, double rtt);
+
+/* new data was ACKed: drop any backoff */
+extern void rto_ack(struct rto *r);
+
+/* a timer expired: double the timeout */
+extern void rto_backoff(struct rto *r);
+
+/* the timeout to start timers with */
+#define rto_timeout(r) ((r)->timeout)
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef SEQ_H
+#define SEQ_H
+
+/* ******************************************************************
+   Sequence number arithmetic.
+
+   Sequence numbers count modulo a size chosen at run time.  Every
+   operation below only ever has to reduce a value in [0, 2 * size),
+   so no division is needed: the reduction is a mask when the size is
+   a power of two and one compare and subtract otherwise.  Building with
+   -DSEQ_POW2_ONLY compiles the mask in unconditionally, and sequence
+   spaces that are not powers of two are then refused at startup.
+**********************************************************************/
+
+struct seqspace {
+  int size;     /* sequence numbers are 0..size-1 */
+  int mask;     /* size - 1 if size is a power of two, else 0 */
+};
+
+#define seq_ispow2(n)  ((n) > 0 && ((n) & ((n) - 1)) == 0)
+
+/* sequence space of n numbers */
+#define seq_init(sp, n) \
+  ((sp)->size = (n), (sp)->mask = seq_ispow2(n) ? (n) - 1 : 0)
+
+/* sizes this build can handle */
+#ifdef SEQ_POW2_ONLY
+#define seq_sizeok(n)  seq_ispow2(n)
+#else
+#define seq_sizeok(n)  ((n) > 0)
+#endif
+
+/* x reduced into the space, for 0 <= x < 2 * size */
+#ifdef SEQ_POW2_ONLY
+#define SEQ_WRAP(sp, x)  ((x) & (sp)->mask)
+#else
+#define SEQ_WRAP(sp, x) \
+  ((sp)->mask ? ((x) & (sp)->mask) : ((x) >= (sp)->size ? (x) - (sp)->size : (x)))
+#endif
+
+/* seqnum a advanced by n, 0 <= n <= size */
+#define SEQ_ADD(sp, a, n)      SEQ_WRAP(sp, (a) + (n))
+
+/* the seqnum before a */
+#define SEQ_PREV(sp, a)        SEQ_WRAP(sp, (a) + (sp)->size - 1)
+
+/* how many steps forward from seqnum from to seqnum to */
+#define SEQ_DIST(sp, from, to) SEQ_WRAP(sp, (to) - (from) + (sp)->size)
+
+#endif
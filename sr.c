@@ -1,8 +1,14 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdbool.h>
 #include "emulator.h"
 #include "sr.h"
+#include "ltimer.h"
+#include "rto.h"
+#include "cc.h"
+#include "seq.h"
+#include "bitset.h"
 
 /* ******************************************************************
    Selective Repeat protocol.  Adapted from J.F.Kurose
@@ -20,278 +26,576 @@
    - removed bidirectional GBN code and other code not used by prac.
    - fixed C style to adhere to current programming style
    - added Selective Repeat implementation
+   - every packet in the window has its own retransmission timer
+   - optional cumulative + selective acknowledgements (--ack-mode sack),
+     which may also be delayed (--ack-every, --ack-delay)
+   - window and sequence space sizes are run-time parameters
+   - bidirectional again (--bidirectional): each entity is a sender and
+     a receiver.  with --ack-mode sack data packets carry the cumulative
+     ACK of the reverse direction
+   - optional congestion control of the sender (--congestion aimd): slow
+     start, AIMD and fast retransmit on duplicate ACKs, see cc.h
 **********************************************************************/
 
 #define RTT  16.0       /* round trip time.  MUST BE SET TO 16.0 when submitting assignment */
-#define WINDOWSIZE 6    /* the maximum number of buffered unacked packet */
-#define SEQSPACE 12     /* sequence space should be at least 2*WINDOWSIZE */
+                        /* (the initial timeout when --adaptive-rto is on) */
+#define WINDOWSIZE 6    /* default maximum number of buffered unacked packet (--window) */
 #define NOTINUSE (-1)   /* used to fill header fields that are not being used */
 
-/* generic procedure to compute the checksum of a packet.  Used by both sender and receiver
-   the simulator will overwrite part of your packet with 'z's.  It will not overwrite your
-   original checksum.  This procedure must generate a different checksum to the original if
-   the packet is corrupted.
-*/
-int ComputeChecksum(struct pkt packet)
+/* the sequence space must be at least 2 * windowsize, and defaults to */
+/* that (see seq_default()) */
+static int configure(struct sim_params *p)
 {
-  int checksum = 0;
-  int i;
-
-  checksum = packet.seqnum;
-  checksum += packet.acknum;
-  for (i = 0; i < 20; i++)
-    checksum += (int)(packet.payload[i]);
-
-  return checksum;
+  if (p->windowsize == 0)
+    p->windowsize = WINDOWSIZE;
+  if (p->seqspace == 0)
+    p->seqspace = seq_default(2 * p->windowsize);
+  if (p->windowsize < 1) {
+    fprintf(stderr, "sr: window must be at least 1\n");
+    return -1;
+  }
+  if (p->seqspace < 2 * p->windowsize) {
+    fprintf(stderr, "sr: sequence space %d is too small for window %d, need at least %d\n",
+            p->seqspace, p->windowsize, 2 * p->windowsize);
+    return -1;
+  }
+  if (!seq_sizeok(p->seqspace)) {
+    fprintf(stderr, "sr: this build only supports power of two sequence spaces\n");
+    return -1;
+  }
+  if (p->ackmode == ACK_SACK && p->windowsize > SACK_MAXBITS) {
+    fprintf(stderr, "sr: a SACK bitmap covers at most %d packets, window is %d\n",
+            SACK_MAXBITS, p->windowsize);
+    return -1;
+  }
+  return 0;
 }
 
-bool IsCorrupted(struct pkt packet)
+/* the state of every entity, as one array per field indexed by entity */
+/* (see entity_of() in emulator.h), so a field of thousands of flows   */
+/* stays dense.  the per-packet arrays give each entity an element for */
+/* every sequence number, those of entity e from SLOT(g, e, 0) on, and */
+/* each bitset is BITS(g, set, e).  without --bidirectional A only     */
+/* sends and B only receives */
+struct sr_state {
+  int windowsize;               /* the maximum number of buffered unacked packet, */
+                                /* and the receive window */
+  struct seqspace seq;          /* sequence numbers */
+  int words;                    /* of each entity's bitsets */
+  int acktimer;                 /* the id of the delayed ACK timer */
+
+  /* the sending halves */
+  struct pkt *buffer;           /* [slot] packets waiting for ACK, see pkt_at() */
+  uint64_t *acked;              /* bitsets, Record which packets have been ACKed */
+  uint64_t *used;               /* bitsets, Mark valid packets */
+  float *sendtime;              /* [slot] when each packet was first sent */
+  bool *resent;                 /* [slot] packet was sent more than once, so gives no RTT sample */
+  int *base;                    /* [e] Minimum window number */
+  int *nextseqnum;              /* [e] Nextseqnum need to be sent */
+  struct rto *rto;              /* [e] retransmission timeout, see rto.h */
+  struct cc *cc;                /* [e] congestion window, see cc.h */
+
+  /* the receiving halves */
+  struct pkt *recv_buffer;      /* [slot] buffer for out-of-order packets */
+  uint64_t *received;           /* bitsets, track which packets are in buffer */
+  int *expected_base;           /* [e] the sequence number expected next by the receiver */
+  int *acknextseqnum;           /* [e] the (unused) sequence number of the next ACK packet */
+  int *unacked;                 /* [e] in-order packets received since the last ACK (delayed ACKs) */
+
+  /* the retransmission timer of each sequence number, then the delayed */
+  /* ACK timer, of each entity, see ltimer.h */
+  struct ltimers *timers;       /* [e] */
+  float *deadline;              /* [e * (acktimer + 1) + id], the arrays of timers[e] */
+  unsigned long *stamp;
+  int *heap, *pos;
+};
+
+#define NAME(e) ('A' + entity_side(e))
+
+/* the per-packet index of sequence number i of entity e, and e's */
+/* words of bitset set */
+#define SLOT(g, e, i)  ((e) * (g)->seq.size + (i))
+#define BITS(g, set, e)  ((g)->set + (size_t)(e) * (g)->words)
+
+/* data carries the cumulative ACK of the reverse direction.  only in */
+/* sack mode: a single-mode ACK names one packet, not a prefix */
+#define PIGGYBACK(sim) ((sim)->params.bidirectional && (sim)->params.ackmode == ACK_SACK)
+
+/* a standalone ACK, or data, has just ACKed everything received in order */
+static void acksent(struct simulation *sim, struct sr_state *g, int e)
 {
-  if (packet.checksum == ComputeChecksum(packet))
-    return (false);
-  else
-    return (true);
+  g->unacked[e] = 0;
+  ltimer_stop(sim, &g->timers[e], g->acktimer);
 }
 
+/* send data packet p, with the current cumulative ACK when piggybacking */
+static void senddata(struct simulation *sim, struct sr_state *g, int e, struct pkt *p)
+{
+  if (PIGGYBACK(sim)) {
+    p->flags = PKT_DATA | PKT_ACK;
+    p->acknum = SEQ_PREV(&g->seq, g->expected_base[e]);
+    p->checksum = ComputeChecksum(sim, p);
+    acksent(sim, g, e);
+  }
+  tolayer3(sim, e, p);
+}
 
-/********* Sender (A) variables and functions ************/
-
-static struct pkt buffer[SEQSPACE];  /* array for storing packets waiting for ACK */
-static bool acked[SEQSPACE];         /* Record which packets have been ACKed */
-static bool used[SEQSPACE];          /* Mark valid packets */
-static int base;                     /* Minimum window number */
-static int nextseqnum;               /* Nextseqnum need to be sent */
-
-/* called from layer 5 (application layer), passed the message to be sent to other side */
-void A_output(struct msg message)
+/* send the ACK for packet seq; with ACK_SACK send the cumulative ACK */
+/* and the bitmap of the packets held after it instead */
+static void sendack(struct simulation *sim, struct sr_state *g, int e, int seq)
 {
   struct pkt sendpkt;
-  int i;
 
-  /* Check if window is not full */
-  if ((nextseqnum - base + SEQSPACE) % SEQSPACE < WINDOWSIZE) {
-    if (TRACE > 1)
-      printf("----A: New message arrives, send window is not full, send new messge to layer3!\n");
+  sendpkt.seqnum = g->acknextseqnum[e];
+  g->acknextseqnum[e] = (g->acknextseqnum[e] + 1) % 2;
+  sendpkt.flags = PKT_ACK;
 
-    /* create packet */
-    sendpkt.seqnum = nextseqnum;
-    sendpkt.acknum = NOTINUSE;
-    for (i = 0; i < 20; i++)
-      sendpkt.payload[i] = message.data[i];
-    sendpkt.checksum = ComputeChecksum(sendpkt);
+  if (sim->params.ackmode == ACK_SACK) {
+    sendpkt.acknum = SEQ_PREV(&g->seq, g->expected_base[e]);
+    sack_encode(&sendpkt, BITS(g, received, e), g->expected_base[e], g->windowsize,
+                g->seq.size);
+  }
+  else {
+    sendpkt.acknum = seq;
+    sendpkt.length = ACKLEN;
+    memset(sendpkt.payload, '0', ACKLEN);
+  }
 
-    /* Store packet in buffer using direct indexing */
-    buffer[nextseqnum] = sendpkt;
-    used[nextseqnum] = true;
-    acked[nextseqnum] = false;
+  sendpkt.checksum = ComputeChecksum(sim, &sendpkt);
+  tolayer3(sim, e, &sendpkt);
+  acksent(sim, g, e);
+}
 
-    /* send out packet */
-    if (TRACE > 0)
-      printf("Sending packet %d to layer 3\n", sendpkt.seqnum);
-    tolayer3(A, sendpkt);
+/* called from layer 5 (application layer), passed the messages to be sent to other side */
+static int output(struct simulation *sim, struct sr_state *g, int e, const struct msg *msgs, int n)
+{
+  const struct msg *m;
+  struct pkt *sendpkt;
+  int i, seq;
+
+  for (i = 0; i < n; i++) {
+    /* if blocked, window is full.  the congestion window can shrink */
+    /* below the packets already in flight */
+    if (SEQ_DIST(&g->seq, g->base[e], g->nextseqnum[e]) >= cc_window(&g->cc[e])) {
+      if (TRACING(sim, 1))
+        trace_printf(sim, "----%c: New message arrives, send window is full\n", NAME(e));
+      break;
+    }
+    if (TRACING(sim, 2))
+      trace_printf(sim, "----%c: New message arrives, send window is not full, send new messge to layer3!\n", NAME(e));
+
+    /* create packet in the buffer, using direct indexing */
+    seq = g->nextseqnum[e];
+    sendpkt = pkt_at(g->buffer, sim->pktstride, SLOT(g, e, seq));
+    m = msg_at(msgs, sim->msgstride, i);
+    sendpkt->seqnum = seq;
+    sendpkt->acknum = NOTINUSE;
+    sendpkt->flags = PKT_DATA;
+    sendpkt->length = m->length;
+    memcpy(sendpkt->payload, m->data, m->length);
+    if (!PIGGYBACK(sim))        /* else senddata() fills in the ACK */
+      sendpkt->checksum = ComputeChecksum(sim, sendpkt);
+    bitset_set(BITS(g, used, e), seq);
+    bitset_clear(BITS(g, acked, e), seq);
+    g->sendtime[SLOT(g, e, seq)] = sim->time;
+    g->resent[SLOT(g, e, seq)] = false;
 
-    /* start timer if first packet in window */
-    if (base == nextseqnum)
-      starttimer(A, RTT);
+    /* send out packet */
+    if (TRACING(sim, 1))
+      trace_printf(sim, "Sending packet %d to layer 3\n", sendpkt->seqnum);
+    senddata(sim, g, e, sendpkt);
+    ltimer_start(sim, &g->timers[e], sendpkt->seqnum, rto_timeout(&g->rto[e]));
 
     /* Increment sequence number */
-    nextseqnum = (nextseqnum + 1) % SEQSPACE;
-  }
-  /* if blocked, window is full */
-  else {
-    if (TRACE > 0)
-      printf("----A: New message arrives, send window is full\n");
-    window_full++;
+    g->nextseqnum[e] = SEQ_ADD(&g->seq, seq, 1);
   }
+  return i;
 }
 
 
-/* called from layer 3, when a packet arrives for layer 4
-   In this practical this will always be an ACK as B never sends data. */
-void A_input(struct pkt packet)
+/* mark in-flight packet seq ACKed.  returns the time it was sent if */
+/* it is a valid RTT sample, -1 if it is not, and -2 if seq was */
+/* already ACKed */
+static double ackpacket(struct simulation *sim, struct sr_state *g, int e, int seq)
 {
-  int ack = packet.acknum;
+  uint64_t *acked = BITS(g, acked, e);
 
-  /* if received ACK is not corrupted and is for a packet we sent */
-  if (!IsCorrupted(packet) && used[ack]) {
-    if (TRACE > 0)
-      printf("----A: uncorrupted ACK %d is received\n", ack);
-    total_ACKs_received++;
+  if (bitset_test(acked, seq))
+    return -2;
+  bitset_set(acked, seq);
+  ltimer_stop(sim, &g->timers[e], seq);
+  return g->resent[SLOT(g, e, seq)] ? -1 : g->sendtime[SLOT(g, e, seq)];   /* Karn's rule */
+}
 
-    /* If not already acknowledged */
-    if (!acked[ack]) {
-      if (TRACE > 0)
-        printf("----A: ACK %d is not a duplicate\n", ack);
-      new_ACKs++;
-      acked[ack] = true;
+/* slide window past consecutive ACKed packets, returns how far it moved */
+static int slidewindow(struct sr_state *g, int e)
+{
+  int outstanding = SEQ_DIST(&g->seq, g->base[e], g->nextseqnum[e]);
+  int k;
+
+  /* a window slot is only ACKed while in flight, so the run stops at nextseqnum */
+  k = bitset_ones(BITS(g, acked, e), g->base[e], g->seq.size, outstanding);
+  bitset_clearrange(BITS(g, acked, e), g->base[e], k, g->seq.size);
+  bitset_clearrange(BITS(g, used, e), g->base[e], k, g->seq.size);
+  g->base[e] = SEQ_ADD(&g->seq, g->base[e], k);
+  return k;
+}
 
-      /* If this is the base packet, slide window */
-      if (ack == base) {
-        /* Stop the timer first */
-        stoptimer(A);
-
-        /* Slide window past consecutive ACKed packets */
-        while (acked[base]) {
-          used[base] = false;
-          acked[base] = false;
-          base = (base + 1) % SEQSPACE;
-        }
-
-        /* Restart timer only if there are still packets in the window */
-        if (base != nextseqnum) {
-          starttimer(A, RTT);
-        }
-      }
-    }
-    else if (TRACE > 0) {
-      printf("----A: duplicate ACK received, do nothing!\n");
-    }
-  }
-  else if (TRACE > 0) {
-    printf("----A: corrupted ACK is received, do nothing!\n");
+/* feed the congestion window an uncorrupted ACK that slid the window */
+/* by slid packets.  standalone ACKs that leave it where it was are    */
+/* duplicates, and the third in a row resends the base packet at once */
+static void congestion(struct simulation *sim, struct sr_state *g, int e,
+                       const struct pkt *packet, int slid)
+{
+  int base = g->base[e];
+  int outstanding = SEQ_DIST(&g->seq, base, g->nextseqnum[e]);
+
+  if (slid > 0) {
+    cc_ack(&g->cc[e], slid);
+    return;
   }
+  if (outstanding == 0 || (packet->flags & PKT_DATA) ||
+      !cc_dupack(&g->cc[e], outstanding))
+    return;
+
+  if (TRACING(sim, 1))
+    trace_printf(sim, "----%c: fast retransmit of packet %d\n", NAME(e), base);
+  senddata(sim, g, e, pkt_at(g->buffer, sim->pktstride, SLOT(g, e, base)));
+  g->resent[SLOT(g, e, base)] = true;
+  sim->stats.packets_resent++;
+  sim->stats.fast_retransmits++;
+  ltimer_start(sim, &g->timers[e], base, rto_timeout(&g->rto[e]));
 }
 
-/* called when A's timer goes off */
-void A_timerinterrupt(void)
+/* ackinput() for ACK_SACK: acknum is the last packet received in order, */
+/* and the payload of a standalone ACK flags the packets after it that */
+/* the other side already holds.  piggybacked ACKs have no bitmap */
+static void ackinput_sack(struct simulation *sim, struct sr_state *g, int e, const struct pkt *packet)
 {
-  if (TRACE > 0)
-    printf("----A: time out,resend packets!\n");
-
-  /* Only retransmit the base packet */
-  if (used[base] && !acked[base]) {
-    if (TRACE > 0)
-      printf("---A: resending packet %d\n", buffer[base].seqnum);
-    tolayer3(A, buffer[base]);
-    packets_resent++;
+  int outstanding = SEQ_DIST(&g->seq, g->base[e], g->nextseqnum[e]);
+  int cum = packet->acknum;
+  bool bitmap = !(packet->flags & PKT_DATA);
+  int n, i, k, seq, slid, newacks = 0;
+  double sent, lastsent = -1;
+
+  if (cum < 0 || cum >= g->seq.size) {
+    if (TRACING(sim, 1))
+      trace_printf(sim, "----%c: corrupted ACK is received, do nothing!\n", NAME(e));
+    return;
+  }
+  if (TRACING(sim, 1))
+    trace_printf(sim, "----%c: uncorrupted ACK %d is received\n", NAME(e), cum);
+  sim->stats.total_ACKs_received++;
+
+  /* everything from base up to cum, if cum is in flight, */
+  /* and the packets held out of order after it */
+  n = SEQ_DIST(&g->seq, g->base[e], cum) + 1;
+  if (n > outstanding)
+    n = 0;
+  for (i = 0; i < outstanding; i++) {
+    seq = SEQ_ADD(&g->seq, g->base[e], i);
+    if (i >= n) {
+      if (!bitmap)
+        break;
+      k = SEQ_DIST(&g->seq, cum, seq) - 1;
+      if (k >= g->windowsize || !sack_isset(packet, k))
+        continue;
+    }
+    if ((sent = ackpacket(sim, g, e, seq)) == -2)
+      continue;
+    newacks++;
+    if (sent > lastsent)
+      lastsent = sent;
   }
 
-  /* Always restart timer */
-  starttimer(A, RTT);
+  if (newacks == 0) {
+    if (TRACING(sim, 1))
+      trace_printf(sim, "----%c: duplicate ACK received, do nothing!\n", NAME(e));
+    congestion(sim, g, e, packet, 0);
+    return;
+  }
+  if (TRACING(sim, 1))
+    trace_printf(sim, "----%c: ACK %d acknowledges %d new packets\n", NAME(e), cum, newacks);
+  sim->stats.new_ACKs++;
+  if (lastsent >= 0)          /* one sample per ACK, from its newest clean packet */
+    rto_sample(&g->rto[e], sim->time - lastsent);
+  rto_ack(&g->rto[e]);
+  slid = slidewindow(g, e);
+  congestion(sim, g, e, packet, slid);
+  if (slid > 0)     /* the window has room again for messages in the backlog */
+    drainbacklog(sim, e);
 }
 
-
-/* the following routine will be called once (only) before any other */
-/* entity A routines are called. You can use it to do any initialization */
-void A_init(void)
+/* the ACK of packet, standalone or carried by data, for the sending half */
+static void ackinput(struct simulation *sim, struct sr_state *g, int e, const struct pkt *packet)
 {
-  int i;
+  int ack = packet->acknum;
+  int slid = 0;
+  double sent;
 
-  /* initialize A's window, buffer and sequence number */
-  base = 0;
-  nextseqnum = 0;  /* A starts with seq num 0, do not change this */
-
-  /* Initialize arrays */
-  for (i = 0; i < SEQSPACE; i++) {
-    acked[i] = false;
-    used[i] = false;
+  if (sim->params.ackmode == ACK_SACK) {
+    ackinput_sack(sim, g, e, packet);
+    return;
   }
-}
 
+  /* if received ACK is for a packet we sent */
+  if (ack >= 0 && ack < g->seq.size && bitset_test(BITS(g, used, e), ack)) {
+    if (TRACING(sim, 1))
+      trace_printf(sim, "----%c: uncorrupted ACK %d is received\n", NAME(e), ack);
+    sim->stats.total_ACKs_received++;
 
-/********* Receiver (B) variables and procedures ************/
+    /* If not already acknowledged */
+    if (!bitset_test(BITS(g, acked, e), ack)) {
+      if (TRACING(sim, 1))
+        trace_printf(sim, "----%c: ACK %d is not a duplicate\n", NAME(e), ack);
+      sim->stats.new_ACKs++;
+      if ((sent = ackpacket(sim, g, e, ack)) >= 0)
+        rto_sample(&g->rto[e], sim->time - sent);
+      rto_ack(&g->rto[e]);
 
-static struct pkt recv_buffer[SEQSPACE];  /* buffer for out-of-order packets */
-static bool received[SEQSPACE];          /* track which packets are in buffer */
-static int expected_base;                /* the sequence number expected next by the receiver */
-static int B_nextseqnum;                 /* the sequence number for the next packets sent by B */
+      /* If this is the base packet, slide window */
+      if (ack == g->base[e])
+        slid = slidewindow(g, e);
+    }
+    else if (TRACING(sim, 1)) {
+      trace_printf(sim, "----%c: duplicate ACK received, do nothing!\n", NAME(e));
+    }
+    congestion(sim, g, e, packet, slid);
+    if (slid > 0)
+      drainbacklog(sim, e);
+  }
+  else if (TRACING(sim, 1)) {
+    trace_printf(sim, "----%c: corrupted ACK is received, do nothing!\n", NAME(e));
+  }
+}
 
-/* called from layer 3, when a packet arrives for layer 4 at B*/
-void B_input(struct pkt packet)
+/* a data packet, for the receiving half */
+static void datainput(struct simulation *sim, struct sr_state *g, int e, const struct pkt *packet)
 {
-  struct pkt sendpkt;
-  int i;
-  int seq = packet.seqnum;
-  int window_end = (expected_base + WINDOWSIZE) % SEQSPACE;
+  uint64_t *received = BITS(g, received, e);
+  int seq = packet->seqnum;
+  struct pkt *held;
   bool in_window;
+  int i, k;
+  bool inorder = false;   /* packet arrived in order and left no gap to report */
 
   /* Check if the packet is within the receive window */
-  if (expected_base <= window_end) {
-    in_window = (seq >= expected_base && seq < window_end);
-  } else {
-    in_window = (seq >= expected_base || seq < window_end);
-  }
+  in_window = seq >= 0 && seq < g->seq.size &&
+              SEQ_DIST(&g->seq, g->expected_base[e], seq) < g->windowsize;
 
-  /* if packet is not corrupted */
-if (!IsCorrupted(packet)) {
-  packets_received++;
+  sim->stats.packets_received++;
 
   if (in_window) {
-    if (TRACE > 0)
-      printf("----B: packet %d is correctly received, send ACK!\n", seq);
-
-    /* If not already received */
-    if (!received[seq]) {
-      /* Store packet */
-      recv_buffer[seq] = packet;
-      received[seq] = true;
-
-      /* If this is the expected packet, deliver consecutive packets */
-      if (seq == expected_base) {
-        while (received[expected_base]) {
-          tolayer5(B, recv_buffer[expected_base].payload);
-          received[expected_base] = false;
-          expected_base = (expected_base + 1) % SEQSPACE;
-        }
+    if (TRACING(sim, 1))
+      trace_printf(sim, "----%c: packet %d is correctly received, send ACK!\n", NAME(e), seq);
+
+    /* If this is the expected packet, deliver it straight from the */
+    /* channel, then the consecutive packets held after it */
+    if (seq == g->expected_base[e]) {
+      tolayer5(sim, e, packet->payload, packet->length);
+      g->expected_base[e] = SEQ_ADD(&g->seq, g->expected_base[e], 1);
+      k = bitset_ones(received, g->expected_base[e], g->seq.size, g->windowsize - 1);
+      for (i = 0; i < k; i++) {
+        held = pkt_at(g->recv_buffer, sim->pktstride,
+                      SLOT(g, e, SEQ_ADD(&g->seq, g->expected_base[e], i)));
+        tolayer5(sim, e, held->payload, held->length);
       }
+      bitset_clearrange(received, g->expected_base[e], k, g->seq.size);
+      g->expected_base[e] = SEQ_ADD(&g->seq, g->expected_base[e], k);
+      inorder = !bitset_any(received, g->seq.size);
+    }
+    /* otherwise store it, if not already received */
+    else if (!bitset_test(received, seq)) {
+      memcpy(pkt_at(g->recv_buffer, sim->pktstride, SLOT(g, e, seq)), packet, pkt_size(packet));
+      bitset_set(received, seq);
     }
   } else {
-    if (TRACE > 0)
-      printf("----B: packet %d is correctly received, send ACK!\n", seq);
+    if (TRACING(sim, 1))
+      trace_printf(sim, "----%c: packet %d is correctly received, send ACK!\n", NAME(e), seq);
   }
 
-  /* Always send ACK for correctly received packet */
-  sendpkt.acknum = seq;
-  sendpkt.seqnum = B_nextseqnum;
-  B_nextseqnum = (B_nextseqnum + 1) % 2;
+  /* Always send ACK for correctly received packet.  Cumulative ACKs */
+  /* of packets that arrived in order may be delayed and coalesced,  */
+  /* or ride on data, see ack_due() */
+  if (inorder && sim->params.ackmode == ACK_SACK && !ack_due(sim, ++g->unacked[e])) {
+    if (!ltimer_running(&g->timers[e], g->acktimer))
+      ltimer_start(sim, &g->timers[e], g->acktimer, sim->params.ackdelay);
+  }
+  else
+    sendack(sim, g, e, seq);
+}
 
-  for (i = 0; i < 20; i++)
-    sendpkt.payload[i] = '0';
+/* called from layer 3, when a packet arrives for layer 4 */
+static void input(struct simulation *sim, struct sr_state *g, int e, const struct pkt *packet)
+{
+  if (IsCorrupted(sim, packet)) {
+    /* only a receive-only entity knows a corrupted packet was data, */
+    /* see gbn.c */
+    if (!sim->params.bidirectional && entity_side(e) == B) {
+      if (TRACING(sim, 1))
+        trace_printf(sim, "----B: packet corrupted or not expected sequence number, resend ACK!\n");
+
+      /* Send ACK for the last correctly received packet */
+      sendack(sim, g, e, SEQ_PREV(&g->seq, g->expected_base[e]));
+    }
+    else if (TRACING(sim, 1))
+      trace_printf(sim, "----%c: corrupted %s is received, do nothing!\n", NAME(e),
+                   sim->params.bidirectional ? "packet" : "ACK");
+    return;
+  }
 
-  sendpkt.checksum = ComputeChecksum(sendpkt);
-  tolayer3(B, sendpkt);
-} else {
-  if (TRACE > 0)
-    printf("----B: packet corrupted or not expected sequence number, resend ACK!\n");
+  if (packet->flags & PKT_ACK)
+    ackinput(sim, g, e, packet);
+  if (packet->flags & PKT_DATA)
+    datainput(sim, g, e, packet);
+}
 
-  /* Send ACK for the last correctly received packet */
-  /* We'll just send an ACK with an invalid acknum for corrupted packets */
-  sendpkt.acknum = (expected_base == 0) ? SEQSPACE - 1 : expected_base - 1;
-  sendpkt.seqnum = B_nextseqnum;
-  B_nextseqnum = (B_nextseqnum + 1) % 2;
+/* called when the entity's timer goes off: resend every packet whose */
+/* own timer expired, and send the delayed ACK when it is due */
+static void timerinterrupt(struct simulation *sim, struct sr_state *g, int e)
+{
+  bool timedout = false;
+  int seq;
+
+  while ((seq = ltimer_expired(sim, &g->timers[e])) >= 0) {
+    if (seq == g->acktimer) {
+      if (g->unacked[e] > 0)
+        sendack(sim, g, e, SEQ_PREV(&g->seq, g->expected_base[e]));
+      continue;
+    }
 
-  for (i = 0; i < 20; i++)
-    sendpkt.payload[i] = '0';
+    if (!timedout) {
+      if (TRACING(sim, 1))
+        trace_printf(sim, "----%c: time out,resend packets!\n", NAME(e));
+      rto_backoff(&g->rto[e]);   /* once per timeout, however many packets expired */
+      cc_timeout(&g->cc[e], SEQ_DIST(&g->seq, g->base[e], g->nextseqnum[e]));
+      timedout = true;
+    }
 
-  sendpkt.checksum = ComputeChecksum(sendpkt);
-  tolayer3(B, sendpkt);
+    if (TRACING(sim, 1))
+      trace_printf(sim, "---%c: resending packet %d\n", NAME(e), seq);
+    senddata(sim, g, e, pkt_at(g->buffer, sim->pktstride, SLOT(g, e, seq)));
+    g->resent[SLOT(g, e, seq)] = true;
+    sim->stats.packets_resent++;
+    ltimer_start(sim, &g->timers[e], seq, rto_timeout(&g->rto[e]));
+  }
 }
 
-/* the following routine will be called once (only) before any other */
-/* entity B routines are called. You can use it to do any initialization */
-void B_init(void)
+
+/* the state and its arrays are one block, widest elements first.  the */
+/* timer arrays have a slot for each sequence number and the ACK timer */
+static size_t statesize(const struct sim_params *params)
 {
-  int i;
+  size_t n = 2 * params->flows, seqs = params->seqspace;
+
+  return sizeof(struct sr_state) +
+         n * (sizeof(struct rto) + sizeof(struct cc) + sizeof(struct ltimers) +
+              3 * BITSET_WORDS(seqs) * sizeof(uint64_t) +
+              (seqs + 1) * (sizeof(unsigned long) + sizeof(float) + 2 * sizeof(int)) +
+              5 * sizeof(int) +
+              seqs * (2 * pkt_stride(params) + sizeof(float) + sizeof(bool)));
+}
 
-  expected_base = 0;
-  B_nextseqnum = 1;
+/* point the state at the arrays after it in its block */
+static void relink(struct simulation *sim)
+{
+  struct sr_state *g = sim->state;
+  size_t n = 2 * sim->params.flows, seqs = sim->params.seqspace;
+  size_t words = BITSET_WORDS(seqs), timers = seqs + 1;
+  char *arrays;
+  size_t e;
+
+  arrays = (char *)(g + 1);
+  g->rto = (struct rto *)arrays;
+  arrays += n * sizeof(struct rto);
+  g->cc = (struct cc *)arrays;
+  arrays += n * sizeof(struct cc);
+  g->timers = (struct ltimers *)arrays;
+  arrays += n * sizeof(struct ltimers);
+  g->acked = (uint64_t *)arrays;
+  g->used = g->acked + n * words;
+  g->received = g->used + n * words;
+  arrays += 3 * n * words * sizeof(uint64_t);
+  g->stamp = (unsigned long *)arrays;
+  arrays += n * timers * sizeof(unsigned long);
+  g->buffer = (struct pkt *)arrays;
+  arrays += n * seqs * sim->pktstride;
+  g->recv_buffer = (struct pkt *)arrays;
+  arrays += n * seqs * sim->pktstride;
+  g->sendtime = (float *)arrays;
+  arrays += n * seqs * sizeof(float);
+  g->deadline = (float *)arrays;
+  arrays += n * timers * sizeof(float);
+  g->heap = (int *)arrays;
+  arrays += n * timers * sizeof(int);
+  g->pos = (int *)arrays;
+  arrays += n * timers * sizeof(int);
+  g->base = (int *)arrays;
+  g->nextseqnum = g->base + n;
+  g->expected_base = g->nextseqnum + n;
+  g->acknextseqnum = g->expected_base + n;
+  g->unacked = g->acknextseqnum + n;
+  arrays += 5 * n * sizeof(int);
+  g->resent = (bool *)arrays;
+
+  g->windowsize = sim->params.windowsize;
+  seq_init(&g->seq, sim->params.seqspace);
+  g->words = words;
+  g->acktimer = seqs;
+  for (e = 0; e < n; e++)
+    ltimer_relink(&g->timers[e], g->deadline + e * timers, g->stamp + e * timers,
+                  g->heap + e * timers, g->pos + e * timers);
+}
 
-  /* Initialize received array */
-  for (i = 0; i < SEQSPACE; i++) {
-    received[i] = false;
-  }
+/* the following routine will be called once (only) before any other */
+/* routines of the entity are called. You can use it to do any initialization */
+static void init(struct simulation *sim, int entity)
+{
+  struct sr_state *g = sim->state;
+  const int e = entity;
+  const int timers = g->acktimer + 1;
+
+  ltimer_init(&g->timers[e], e, timers, g->deadline + e * timers, g->stamp + e * timers,
+              g->heap + e * timers, g->pos + e * timers);
+
+  /* initialize the send window, buffer and sequence number */
+  g->base[e] = 0;
+  g->nextseqnum[e] = 0;  /* A starts with seq num 0, do not change this */
+  rto_init(&g->rto[e], sim->params.adaptiverto, RTT);
+  cc_init(&g->cc[e], sim->params.congestion, g->windowsize);
+  bitset_zero(BITS(g, acked, e), g->seq.size);
+  bitset_zero(BITS(g, used, e), g->seq.size);
+
+  /* and the receive window */
+  g->expected_base[e] = 0;
+  g->acknextseqnum[e] = 1;
+  g->unacked[e] = 0;
+  bitset_zero(BITS(g, received, e), g->seq.size);
 }
 
-/******************************************************************************
- * The following functions need be completed only for bi-directional messages *
- *****************************************************************************/
+/* the entry points, for either side of any flow */
 
-/* Note that with simplex transfer from a-to-B, there is no B_output() */
-void B_output(struct msg message)
+static int entry_output(struct simulation *sim, int entity, const struct msg *msgs, int n)
 {
+  return output(sim, sim->state, entity, msgs, n);
 }
 
-/* called when B's timer goes off */
-void B_timerinterrupt(void)
+static void entry_input(struct simulation *sim, int entity, const struct pkt *packet)
 {
-}
\ No newline at end of file
+  input(sim, sim->state, entity, packet);
+}
+
+static void entry_timerinterrupt(struct simulation *sim, int entity)
+{
+  timerinterrupt(sim, sim->state, entity);
+}
+
+const struct protocol sr_protocol = {
+  "sr", "Selective Repeat",
+  configure,
+  init,
+  entry_output,
+  entry_input,
+  entry_timerinterrupt,
+  statesize, relink
+};
@@ -0,0 +1,485 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <pthread.h>
+#include "emulator.h"
+#include "checkpoint.h"
+#include "sweep.h"
+
+/* ******************************************************************
+   Multi-threaded parameter sweeps, see sweep.h.
+
+   Every (cell, seed) pair is one task.  Tasks are dealt round robin
+   onto one deque per worker thread.  A worker takes tasks from the
+   back of its own deque and, once that is empty, steals from the front
+   of the others, so a few slow high-loss cells do not leave the other
+   threads idle.  Tasks never create new tasks, so a worker that finds
+   every deque empty is done.
+**********************************************************************/
+
+#define MAX_AXES     8     /* parameters that can be swept at once */
+#define MAX_THREADS  256
+
+struct axis {
+  const char *name;        /* parameter being swept */
+  int nvalues;
+  char **values;           /* text value of each grid point */
+};
+
+/* figures derived from a finished run */
+static double simtime(const struct simulation *sim) { return sim->time; }
+static double goodput(const struct simulation *sim) { return sim_goodput(sim); }
+static double utilAB(const struct simulation *sim) { return sim_utilisation(sim, B); }
+static double utilBA(const struct simulation *sim) { return sim_utilisation(sim, A); }
+static double resentpermsg(const struct simulation *sim) { return sim_resentpermsg(sim); }
+static double fairness(const struct simulation *sim) { return sim_fairness(sim); }
+static double latmean(const struct simulation *sim) { return hist_mean(&sim->stats.latency); }
+static double latp50(const struct simulation *sim) { return hist_percentile(&sim->stats.latency, 0.5); }
+static double latp99(const struct simulation *sim) { return hist_percentile(&sim->stats.latency, 0.99); }
+static double latp999(const struct simulation *sim) { return hist_percentile(&sim->stats.latency, 0.999); }
+
+static double queuedelay(const struct simulation *sim)
+{
+  return sim->stats.backlogged > 0 ? sim->stats.queue_delay / sim->stats.backlogged : 0.0;
+}
+
+/* statistics collected from every run, in output order */
+struct metric {
+  const char *name;
+  size_t offset;           /* int field in struct sim_stats, if derive is NULL */
+  double (*derive)(const struct simulation *sim);
+};
+
+static const struct metric metrics[] = {
+  { "sim_time",            0, simtime },
+  { "goodput",             0, goodput },
+  { "latency_mean",        0, latmean },
+  { "latency_p50",         0, latp50 },
+  { "latency_p99",         0, latp99 },
+  { "latency_p999",        0, latp999 },
+  { "utilisation_AtoB",    0, utilAB },
+  { "utilisation_BtoA",    0, utilBA },
+  { "resent_per_message",  0, resentpermsg },
+  { "fairness",            0, fairness },
+  { "queue_delay",         0, queuedelay },
+  { "window_full",         offsetof(struct sim_stats, window_full), NULL },
+  { "backlogged",          offsetof(struct sim_stats, backlogged), NULL },
+  { "backlog_max",         offsetof(struct sim_stats, backlog_max), NULL },
+  { "total_ACKs_received", offsetof(struct sim_stats, total_ACKs_received), NULL },
+  { "new_ACKs",            offsetof(struct sim_stats, new_ACKs), NULL },
+  { "packets_resent",      offsetof(struct sim_stats, packets_resent), NULL },
+  { "fast_retransmits",    offsetof(struct sim_stats, fast_retransmits), NULL },
+  { "packets_received",    offsetof(struct sim_stats, packets_received), NULL },
+  { "messages_delivered",  offsetof(struct sim_stats, messages_delivered), NULL },
+  { "packets_to_layer3",   offsetof(struct sim_stats, ntolayer3), NULL },
+  { "packets_lost",        offsetof(struct sim_stats, nlost), NULL },
+  { "packets_dropped",     offsetof(struct sim_stats, ndropped), NULL },
+  { "packets_corrupted",   offsetof(struct sim_stats, ncorrupt), NULL },
+};
+
+#define NUM_METRICS (int)(sizeof(metrics) / sizeof(metrics[0]))
+
+struct sweep;
+
+struct worker {
+  pthread_t thread;
+  pthread_mutex_t lock;    /* protects head and tail */
+  int *tasks;              /* this worker's deque of task numbers */
+  int head, tail;          /* tasks[head..tail-1] are still to run */
+  int id;
+  struct sweep *sw;
+};
+
+struct sweep {
+  struct sim_params base;        /* parameters shared by every run */
+  struct axis axes[MAX_AXES];
+  int naxes;
+  int ncells;                    /* product of the axis lengths */
+  int nseeds;                    /* runs per cell */
+  int nthreads;
+  double *results;               /* NUM_METRICS values per task */
+  char *failed;                  /* per task, 1 if the run could not start */
+  struct worker *workers;
+  struct checkpoint *ck;         /* every run carries on from it, NULL for none */
+};
+
+/* the value of axis a in grid cell cell; the last axis varies fastest */
+static const char *cellvalue(const struct sweep *sw, int cell, int a)
+{
+  int i;
+
+  for (i = sw->naxes - 1; i > a; i--)
+    cell /= sw->axes[i].nvalues;
+  return sw->axes[a].values[cell % sw->axes[a].nvalues];
+}
+
+/* parameters of grid cell cell; returns -1 if an axis value is invalid */
+static int cellparams(const struct sweep *sw, int cell, struct sim_params *p)
+{
+  int a;
+
+  *p = sw->base;
+  for (a = 0; a < sw->naxes; a++)
+    if (params_set(p, sw->axes[a].name, cellvalue(sw, cell, a)) < 0)
+      return -1;
+  return 0;
+}
+
+static void runtask(struct sweep *sw, int task)
+{
+  struct sim_params p;
+  struct simulation *sim;
+  double *m = &sw->results[(size_t)task * NUM_METRICS];
+  int i;
+
+  cellparams(sw, task / sw->nseeds, &p);
+  p.seed = sw->base.seed + (unsigned long)(task % sw->nseeds);
+  p.trace = 0;
+  p.tracefile[0] = '\0';
+  p.evlogfile[0] = '\0';
+  p.statsjson[0] = '\0';
+  p.checkpoint[0] = '\0';
+  p.rngselftest = 0;
+  sim = (sw->ck != NULL) ? sim_restore(sw->ck, &p) : sim_create(&p);
+  if (sim == NULL) {
+    sw->failed[task] = 1;
+    return;
+  }
+  sim_run(sim);
+
+  for (i = 0; i < NUM_METRICS; i++)
+    if (metrics[i].derive != NULL)
+      m[i] = metrics[i].derive(sim);
+    else
+      m[i] = *(const int *)((const char *)&sim->stats + metrics[i].offset);
+  sim_destroy(sim);
+}
+
+/* take the next task for worker w, stealing if its own deque is empty. */
+/* returns -1 when there is nothing left anywhere */
+static int nexttask(struct worker *w)
+{
+  struct sweep *sw = w->sw;
+  struct worker *v;
+  int i, task = -1;
+
+  pthread_mutex_lock(&w->lock);
+  if (w->head < w->tail)
+    task = w->tasks[--w->tail];
+  pthread_mutex_unlock(&w->lock);
+
+  for (i = 1; task < 0 && i < sw->nthreads; i++) {
+    v = &sw->workers[(w->id + i) % sw->nthreads];
+    pthread_mutex_lock(&v->lock);
+    if (v->head < v->tail)
+      task = v->tasks[v->head++];
+    pthread_mutex_unlock(&v->lock);
+  }
+  return task;
+}
+
+static void *workermain(void *arg)
+{
+  struct worker *w = arg;
+  int task;
+
+  while ((task = nexttask(w)) >= 0)
+    runtask(w->sw, task);
+  return NULL;
+}
+
+/* two-sided 95% Student t quantiles for 1..30 degrees of freedom */
+static const double tquantile[] = {
+  12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+  2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+  2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+/* mean and 95% confidence half-width of metric m over the runs of cell */
+static int cellstats(const struct sweep *sw, int cell, int m, double *mean, double *ci)
+{
+  double sum = 0.0, sumsq = 0.0, x, var;
+  int k, task, n = 0;
+
+  for (k = 0; k < sw->nseeds; k++) {
+    task = cell * sw->nseeds + k;
+    if (sw->failed[task])
+      continue;
+    x = sw->results[(size_t)task * NUM_METRICS + m];
+    sum += x;
+    n++;
+  }
+  *mean = (n > 0) ? sum / n : 0.0;
+  for (k = 0; k < sw->nseeds; k++) {
+    task = cell * sw->nseeds + k;
+    if (sw->failed[task])
+      continue;
+    x = sw->results[(size_t)task * NUM_METRICS + m] - *mean;
+    sumsq += x * x;
+  }
+  *ci = 0.0;
+  if (n > 1) {
+    var = sumsq / (n - 1);
+    *ci = ((n - 1 <= 30) ? tquantile[n - 2] : 1.960) * sqrt(var / n);
+  }
+  return n;
+}
+
+/* print s as a JSON number if it is one, otherwise as a JSON string */
+static void jsonvalue(FILE *fp, const char *s)
+{
+  char *end;
+
+  strtod(s, &end);
+  if (end != s && *end == '\0')
+    fprintf(fp, "%s", s);
+  else
+    fprintf(fp, "\"%s\"", s);
+}
+
+static void writecsv(const struct sweep *sw, FILE *fp)
+{
+  double mean, ci;
+  int a, c, m, n;
+
+  for (a = 0; a < sw->naxes; a++)
+    fprintf(fp, "%s,", sw->axes[a].name);
+  fprintf(fp, "runs");
+  for (m = 0; m < NUM_METRICS; m++)
+    fprintf(fp, ",%s_mean,%s_ci95", metrics[m].name, metrics[m].name);
+  fprintf(fp, "\n");
+
+  for (c = 0; c < sw->ncells; c++) {
+    for (a = 0; a < sw->naxes; a++)
+      fprintf(fp, "%s,", cellvalue(sw, c, a));
+    n = cellstats(sw, c, 0, &mean, &ci);
+    fprintf(fp, "%d", n);
+    for (m = 0; m < NUM_METRICS; m++) {
+      cellstats(sw, c, m, &mean, &ci);
+      fprintf(fp, ",%.6g,%.6g", mean, ci);
+    }
+    fprintf(fp, "\n");
+  }
+}
+
+static void writejson(const struct sweep *sw, FILE *fp)
+{
+  double mean, ci;
+  int a, c, m, n;
+
+  fprintf(fp, "[\n");
+  for (c = 0; c < sw->ncells; c++) {
+    fprintf(fp, "  {");
+    for (a = 0; a < sw->naxes; a++) {
+      fprintf(fp, "\"%s\": ", sw->axes[a].name);
+      jsonvalue(fp, cellvalue(sw, c, a));
+      fprintf(fp, ", ");
+    }
+    n = cellstats(sw, c, 0, &mean, &ci);
+    fprintf(fp, "\"runs\": %d,\n   \"metrics\": {", n);
+    for (m = 0; m < NUM_METRICS; m++) {
+      cellstats(sw, c, m, &mean, &ci);
+      fprintf(fp, "%s\n     \"%s\": {\"mean\": %.6g, \"ci95\": %.6g}",
+              m ? "," : "", metrics[m].name, mean, ci);
+    }
+    fprintf(fp, "}}%s\n", (c + 1 < sw->ncells) ? "," : "");
+  }
+  fprintf(fp, "]\n");
+}
+
+/* parse "name=v1,v2,..." or "name=from:to:step" into an axis */
+static int parseaxis(struct axis *ax, char *spec)
+{
+  char *eq, *list, *tok, *save;
+  char buf[64];
+  double from, to, step, x;
+  int n;
+
+  if ((eq = strchr(spec, '=')) == NULL || eq == spec || eq[1] == '\0') {
+    fprintf(stderr, "sweep: expected --axis name=values, got '%s'\n", spec);
+    return -1;
+  }
+  *eq = '\0';
+  ax->name = spec;
+  list = eq + 1;
+  ax->nvalues = 0;
+  ax->values = NULL;
+
+  if (sscanf(list, "%lf:%lf:%lf", &from, &to, &step) == 3 && strchr(list, ',') == NULL) {
+    if (step <= 0.0 || to < from) {
+      fprintf(stderr, "sweep: bad range '%s' for %s\n", list, ax->name);
+      return -1;
+    }
+    n = (int)floor((to - from) / step + 1e-9) + 1;
+    ax->values = malloc(n * sizeof(char *));
+    for (ax->nvalues = 0; ax->nvalues < n; ax->nvalues++) {
+      x = from + ax->nvalues * step;
+      snprintf(buf, sizeof(buf), "%.10g", x);
+      ax->values[ax->nvalues] = strdup(buf);
+    }
+    return 0;
+  }
+
+  n = 1;
+  for (tok = list; *tok; tok++)
+    if (*tok == ',')
+      n++;
+  ax->values = malloc(n * sizeof(char *));
+  for (tok = strtok_r(list, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save))
+    ax->values[ax->nvalues++] = strdup(tok);
+  if (ax->nvalues == 0) {
+    fprintf(stderr, "sweep: no values for %s\n", ax->name);
+    return -1;
+  }
+  return 0;
+}
+
+static void sweepusage(void)
+{
+  printf("usage: sweep [--axis name=v1,v2,...|name=from:to:step]... [--seeds N]\n");
+  printf("             [--threads N] [--format csv|json] [--output FILE]\n");
+  printf("             [parameter flags...]\n");
+}
+
+int sweep_main(int argc, char **argv)
+{
+  struct sweep sw;
+  struct sim_params check;
+  char **rest;
+  const char *output = NULL, *format = "csv";
+  FILE *fp;
+  int i, c, nrest = 1, ntasks, status = EXIT_SUCCESS;
+
+  memset(&sw, 0, sizeof(sw));
+  sw.nseeds = 1;
+  sw.nthreads = 1;
+  params_default(&sw.base);
+
+  /* pick out the sweep options, pass the rest on as parameter flags */
+  rest = malloc((argc + 1) * sizeof(char *));
+  rest[0] = argv[0];
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+      sweepusage();
+      free(rest);
+      return EXIT_SUCCESS;
+    }
+    if (i + 1 < argc && strcmp(argv[i], "--axis") == 0) {
+      if (sw.naxes == MAX_AXES) {
+        fprintf(stderr, "sweep: at most %d axes\n", MAX_AXES);
+        free(rest);
+        return EXIT_FAILURE;
+      }
+      if (parseaxis(&sw.axes[sw.naxes++], argv[++i]) < 0) {
+        free(rest);
+        return EXIT_FAILURE;
+      }
+    }
+    else if (i + 1 < argc && strcmp(argv[i], "--seeds") == 0)
+      sw.nseeds = atoi(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "--threads") == 0)
+      sw.nthreads = atoi(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "--output") == 0)
+      output = argv[++i];
+    else if (i + 1 < argc && strcmp(argv[i], "--format") == 0)
+      format = argv[++i];
+    else
+      rest[nrest++] = argv[i];
+  }
+  rest[nrest] = NULL;
+  i = params_parse_args(&sw.base, nrest, rest);
+  if (i >= 0 && sw.base.restore[0] != '\0') {
+    /* the flags apply on top of the checkpoint's parameters */
+    if ((sw.ck = checkpoint_open(sw.base.restore)) == NULL)
+      i = -1;
+    else {
+      sw.base = sw.ck->params;
+      i = params_parse_args(&sw.base, nrest, rest);
+    }
+  }
+  free(rest);
+  if (i < 0) {
+    if (sw.ck != NULL)
+      checkpoint_close(sw.ck);
+    return EXIT_FAILURE;
+  }
+
+  if (sw.nseeds < 1 || sw.nthreads < 1 || sw.nthreads > MAX_THREADS) {
+    fprintf(stderr, "sweep: need at least one seed and 1..%d threads\n", MAX_THREADS);
+    return EXIT_FAILURE;
+  }
+  if (strcmp(format, "csv") != 0 && strcmp(format, "json") != 0) {
+    fprintf(stderr, "sweep: unknown format %s\n", format);
+    return EXIT_FAILURE;
+  }
+
+  sw.ncells = 1;
+  for (i = 0; i < sw.naxes; i++)
+    sw.ncells *= sw.axes[i].nvalues;
+  for (c = 0; c < sw.ncells; c++)      /* reject bad values before starting */
+    if (cellparams(&sw, c, &check) < 0)
+      return EXIT_FAILURE;
+
+  if (sw.ncells > 10000000 / sw.nseeds) {
+    fprintf(stderr, "sweep: too many runs\n");
+    return EXIT_FAILURE;
+  }
+  ntasks = sw.ncells * sw.nseeds;
+  sw.results = calloc((size_t)ntasks * NUM_METRICS, sizeof(double));
+  sw.failed = calloc((size_t)ntasks, 1);
+  sw.workers = calloc(sw.nthreads, sizeof(struct worker));
+  if (sw.results == NULL || sw.failed == NULL || sw.workers == NULL) {
+    fprintf(stderr, "sweep: out of memory\n");
+    return EXIT_FAILURE;
+  }
+
+  for (i = 0; i < sw.nthreads; i++) {
+    sw.workers[i].id = i;
+    sw.workers[i].sw = &sw;
+    sw.workers[i].tasks = malloc((ntasks / sw.nthreads + 1) * sizeof(int));
+    pthread_mutex_init(&sw.workers[i].lock, NULL);
+  }
+  for (i = 0; i < ntasks; i++) {       /* deal the tasks out round robin */
+    struct worker *w = &sw.workers[i % sw.nthreads];
+    w->tasks[w->tail++] = i;
+  }
+  for (i = 0; i < sw.nthreads; i++)
+    pthread_create(&sw.workers[i].thread, NULL, workermain, &sw.workers[i]);
+  for (i = 0; i < sw.nthreads; i++)
+    pthread_join(sw.workers[i].thread, NULL);
+
+  fp = stdout;
+  if (output != NULL && (fp = fopen(output, "w")) == NULL) {
+    fprintf(stderr, "sweep: cannot write %s\n", output);
+    status = EXIT_FAILURE;
+  }
+  else {
+    if (strcmp(format, "json") == 0)
+      writejson(&sw, fp);
+    else
+      writecsv(&sw, fp);
+    if (fp != stdout)
+      fclose(fp);
+  }
+
+  for (i = 0; i < ntasks; i++)
+    if (sw.failed[i])
+      status = EXIT_FAILURE;
+  for (i = 0; i < sw.nthreads; i++) {
+    pthread_mutex_destroy(&sw.workers[i].lock);
+    free(sw.workers[i].tasks);
+  }
+  for (i = 0; i < sw.naxes; i++) {
+    for (c = 0; c < sw.axes[i].nvalues; c++)
+      free(sw.axes[i].values[c]);
+    free(sw.axes[i].values);
+  }
+  free(sw.workers);
+  free(sw.failed);
+  free(sw.results);
+  if (sw.ck != NULL)
+    checkpoint_close(sw.ck);
+  return status;
+}
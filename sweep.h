@@ -0,0 +1,26 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+/* ******************************************************************
+   Parameter sweeps.
+
+   A sweep runs one simulation for every combination of the values
+   given for each swept parameter (a grid cell) and every seed, spread
+   over a pool of worker threads.  The statistics of each cell are
+   averaged over its seeds and written as one CSV or JSON table, with
+   a 95% confidence interval for every metric.
+
+   usage: prog sweep [--axis name=v1,v2,...]... [--axis name=from:to:step]
+                     [--seeds N] [--threads N] [--format csv|json]
+                     [--output FILE] [parameter flags...]
+
+   name is any simulation parameter (see params.h); parameters that are
+   not swept take the value given by the ordinary flags or config
+   files.  Cell i, seed k runs with seed = base seed + k.
+**********************************************************************/
+
+/* run a sweep from command-line arguments (argv[0] is "sweep").  */
+/* returns the process exit status */
+extern int sweep_main(int argc, char **argv);
+
+#endif
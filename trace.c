@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "emulator.h"
+#include "trace.h"
+
+int trace_open(struct trace_sink *t, const char *file)
+{
+  t->fp = stdout;
+  t->owned = 0;
+  if (file != NULL && file[0] != '\0') {
+    if ((t->fp = fopen(file, "w")) == NULL) {
+      fprintf(stderr, "cannot open trace file %s\n", file);
+      t->fp = stdout;
+      return -1;
+    }
+    t->owned = 1;
+  }
+  return 0;
+}
+
+void trace_flush(struct trace_sink *t)
+{
+  if (t->len > 0 && t->fp != NULL) {
+    fwrite(t->buf, 1, t->len, t->fp);
+    fflush(t->fp);
+  }
+  t->len = 0;
+}
+
+void trace_close(struct trace_sink *t)
+{
+  trace_flush(t);
+  if (t->owned)
+    fclose(t->fp);
+  free(t->buf);
+  t->fp = NULL;
+  t->buf = NULL;
+  t->owned = 0;
+}
+
+void trace_printf(struct simulation *sim, const char *fmt, ...)
+{
+  struct trace_sink *t = &sim->trace;
+  va_list ap;
+  size_t room;
+  int n;
+
+  if (t->fp == NULL)
+    t->fp = stdout;
+  if (t->buf == NULL && (t->buf = malloc(TRACE_BUFSIZE)) == NULL) {
+    va_start(ap, fmt);          /* no buffer, write straight through */
+    vfprintf(t->fp, fmt, ap);
+    va_end(ap);
+    return;
+  }
+
+  room = TRACE_BUFSIZE - t->len;
+  va_start(ap, fmt);
+  n = vsnprintf(t->buf + t->len, room, fmt, ap);
+  va_end(ap);
+  if (n < 0)
+    return;
+  if ((size_t)n < room) {
+    t->len += n;
+    return;
+  }
+
+  /* did not fit: empty the buffer and try again */
+  trace_flush(t);
+  va_start(ap, fmt);
+  if ((size_t)n < TRACE_BUFSIZE)
+    t->len = vsnprintf(t->buf, TRACE_BUFSIZE, fmt, ap);
+  else
+    vfprintf(t->fp, fmt, ap);   /* longer than the whole buffer */
+  va_end(ap);
+}
@@ -0,0 +1,60 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* ******************************************************************
+   Tracing.
+
+   Trace points are written as
+
+       if (TRACING(sim, 2))
+         trace_printf(sim, "...", ...);
+
+   and fire when the run's trace level is at least the given level.
+   Levels above TRACE_MAX are compiled out completely: building with
+   -DTRACE_MAX=0 leaves only the level 0 warnings, so production
+   sweeps pay nothing for the trace points.  Trace output goes through
+   a per-simulation buffer that is written out in large blocks rather
+   than through line-buffered printf.
+**********************************************************************/
+
+#ifndef TRACE_MAX
+#define TRACE_MAX 4     /* highest trace level compiled in */
+#endif
+
+#define TRACE_BUFSIZE  (64 * 1024)
+
+/* buffered destination of one simulation's trace output */
+struct trace_sink {
+  FILE *fp;     /* where the buffer is written, NULL until first use */
+  int owned;    /* fp was opened by the sink and is closed with it */
+  char *buf;
+  size_t len;   /* bytes waiting in buf */
+};
+
+/* true if trace points of level should fire in simulation sim */
+#define TRACING(sim, level) \
+  ((level) <= TRACE_MAX && (sim)->params.trace >= (level))
+
+struct simulation;
+
+/* format a trace message into the simulation's trace sink */
+extern void trace_printf(struct simulation *sim, const char *fmt, ...)
+#ifdef __GNUC__
+  __attribute__((format(printf, 2, 3)))
+#endif
+  ;
+
+/* direct the sink to file (stdout if file is NULL or empty). */
+/* returns 0, or -1 if the file cannot be opened */
+extern int trace_open(struct trace_sink *t, const char *file);
+
+/* write out everything buffered so far */
+extern void trace_flush(struct trace_sink *t);
+
+/* flush, close and release the sink */
+extern void trace_close(struct trace_sink *t);
+
+#endif
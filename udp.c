@@ -0,0 +1,707 @@
+#define _GNU_SOURCE             /* recvmmsg() and sendmmsg() */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "udp.h"
+#include "cc.h"
+#include "protocol.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#define UDP_MAXBATCH  1024
+#define UDP_ROUNDS    64        /* full batches read before looking at the timer again */
+#define UDP_TICK      100       /* ms between checks for the end of the run */
+
+/* one side of a flow, talking to the other over a socket */
+struct udplink {
+  struct simulation *sim;
+  int entity;                   /* the side of flow 0 running here */
+  int fd, tfd, ep;              /* socket, timerfd and the epoll watching both */
+  double start, unit;           /* CLOCK_MONOTONIC seconds at time 0, seconds per time unit */
+  double heard;                 /* seconds when the peer was last heard from */
+  double began;                 /* seconds when the first datagram went or came, 0 until then */
+  double finished;              /* seconds when the transfer was complete, 0 until then */
+  float deadline;               /* time the timer goes off, -1 if it is off */
+  float armed;                  /* time the timerfd is set to, -1 if it is not */
+
+  /* datagrams, batch of each kind in slots of slot bytes */
+  int batch, nout;              /* ... and outgoing datagrams queued */
+  int room;                     /* most payload bytes a packet of the run carries */
+  size_t slot;
+  struct mmsghdr *outmsg, *inmsg;
+  struct iovec *outiov, *iniov;
+  char *outbuf, *inbuf;
+
+  /* layer 5 */
+  FILE *src, *dst;              /* file streamed out, file written, NULL if none */
+  struct msg *msgs;             /* messages read from src, msgstride bytes apart ... */
+  size_t msgstride;
+  int nmsgs, first;             /* ... and the first the protocol has not accepted */
+  int eof;                      /* src is exhausted and msgs ends with the empty message */
+  int ended;                    /* the protocol accepted the empty message */
+  int received;                 /* the empty message of the peer was delivered */
+  int producing;                /* in udp_drain() */
+
+  /* counters */
+  long long bytesout, bytesin;
+  long msgsout, msgsin;
+  long dgsent, sendcalls, senderrors;
+  long dgrecv, recvcalls, malformed;
+};
+
+static double monotonic(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* bring the emulator's clock up to the wall clock; it never goes back */
+static double settime(struct udplink *l)
+{
+  double now = monotonic();
+  float t = (float)((now - l->start) / l->unit);
+
+  if (t > l->sim->time)
+    l->sim->time = t;
+  return now;
+}
+
+/* set the timerfd to go off at time at */
+static void arm(struct udplink *l, float at)
+{
+  struct itimerspec its;
+  double s = l->start + at * l->unit;
+
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec = (time_t)s;
+  its.it_value.tv_nsec = (long)((s - floor(s)) * 1e9);
+  if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+    its.it_value.tv_nsec = 1;   /* all zeros would disarm it */
+  timerfd_settime(l->tfd, TFD_TIMER_ABSTIME, &its, NULL);
+  l->armed = at;
+}
+
+/* the timerfd went off */
+static void timerexpired(struct udplink *l)
+{
+  uint64_t n;
+  float at = l->armed;
+
+  if (read(l->tfd, &n, sizeof(n)) != sizeof(n))
+    return;
+  l->armed = -1;
+  /* stopped since, or restarted for later: the main loop sets it again */
+  if (l->deadline < 0 || l->deadline > at)
+    return;
+  if (l->sim->time < l->deadline)
+    l->sim->time = l->deadline;
+  l->deadline = -1;
+  if (TRACING(l->sim, 2))
+    trace_printf(l->sim, "\nEVENT time: %f,  type: 0, timerinterrupt  entity: %d\n",
+                 l->sim->time, l->entity);
+  l->sim->params.protocol->timerinterrupt(l->sim, l->entity);
+}
+
+void udp_starttimer(struct udplink *l, double increment)
+{
+  if (TRACING(l->sim, 2))
+    trace_printf(l->sim, "          START TIMER: starting timer at %f\n", l->sim->time);
+  if (l->deadline >= 0) {
+    trace_printf(l->sim, "Warning: attempt to start a timer that is already started\n");
+    return;
+  }
+  l->deadline = l->sim->time + increment;
+}
+
+void udp_stoptimer(struct udplink *l)
+{
+  if (TRACING(l->sim, 2))
+    trace_printf(l->sim, "          STOP TIMER: stopping timer at %f\n", l->sim->time);
+  if (l->deadline < 0) {
+    trace_printf(l->sim, "Warning: unable to cancel your timer. It wasn't running.\n");
+    return;
+  }
+  /* the timerfd stays set, and is ignored when it goes off */
+  l->deadline = -1;
+}
+
+/* send the queued datagrams */
+static void flush(struct udplink *l)
+{
+  int i = 0, n;
+
+  if (l->began == 0 && l->nout > 0)
+    l->began = monotonic();
+  while (i < l->nout) {
+    n = sendmmsg(l->fd, l->outmsg + i, l->nout - i, 0);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      /* the peer is not listening (yet), or the route is down: the */
+      /* datagram is lost, as on any channel */
+      l->senderrors++;
+      i++;
+      continue;
+    }
+    l->sendcalls++;
+    l->dgsent += n;
+    i += n;
+  }
+  l->nout = 0;
+}
+
+void udp_tolayer3(struct udplink *l, const struct pkt *packet)
+{
+  uint32_t h[5];
+  char *slot;
+
+  if (TRACING(l->sim, 3))
+    trace_printf(l->sim, "          TOLAYER3: seq: %d, ack %d, check: %d %.*s\n", packet->seqnum,
+                 packet->acknum, packet->checksum, packet->length, packet->payload);
+  if (l->nout == l->batch)
+    flush(l);
+  h[0] = htonl((uint32_t)packet->seqnum);
+  h[1] = htonl((uint32_t)packet->acknum);
+  h[2] = htonl((uint32_t)packet->checksum);
+  h[3] = htonl((uint32_t)packet->length);
+  h[4] = htonl((uint32_t)packet->flags);
+  slot = l->outbuf + l->nout * l->slot;
+  memcpy(slot, h, UDP_HDRLEN);
+  memcpy(slot + UDP_HDRLEN, packet->payload, packet->length);
+  l->outiov[l->nout].iov_len = UDP_HDRLEN + packet->length;
+  l->nout++;
+}
+
+/* the packet in datagram d of n bytes, -1 if it is not one of ours */
+/* or carries more than room bytes */
+static int decode(struct pkt *p, const char *d, size_t n, int room)
+{
+  uint32_t h[5];
+
+  if (n < UDP_HDRLEN)
+    return -1;
+  memcpy(h, d, UDP_HDRLEN);
+  p->seqnum = (int)ntohl(h[0]);
+  p->acknum = (int)ntohl(h[1]);
+  p->checksum = (int)ntohl(h[2]);
+  p->length = (int)ntohl(h[3]);
+  p->flags = (int)ntohl(h[4]);
+  if (p->length < 0 || p->length > room || (size_t)p->length != n - UDP_HDRLEN)
+    return -1;
+  memcpy(p->payload, d + UDP_HDRLEN, p->length);
+  return 0;
+}
+
+/* read one batch of datagrams and pass them to the protocol.  returns */
+/* how many were read */
+static int receive(struct udplink *l)
+{
+  struct pkt packet;
+  int i, n;
+
+  n = recvmmsg(l->fd, l->inmsg, l->batch, MSG_DONTWAIT, NULL);
+  if (n <= 0)                   /* nothing waiting, or an ICMP error */
+    return 0;
+  l->recvcalls++;
+  l->heard = settime(l);
+  if (l->began == 0)
+    l->began = l->heard;
+  for (i = 0; i < n; i++) {
+    if (decode(&packet, l->inbuf + i * l->slot, l->inmsg[i].msg_len, l->room) < 0 ||
+        (l->inmsg[i].msg_hdr.msg_flags & MSG_TRUNC)) {
+      l->malformed++;
+      continue;
+    }
+    l->dgrecv++;
+    if (TRACING(l->sim, 2))
+      trace_printf(l->sim, "\nEVENT time: %f,  type: 2, fromlayer3  entity: %d\n",
+                   l->sim->time, l->entity);
+    l->sim->params.protocol->input(l->sim, l->entity, &packet);
+  }
+  return n;
+}
+
+void udp_tolayer5(struct udplink *l, const char *data, int length)
+{
+  if (TRACING(l->sim, 3))
+    trace_printf(l->sim, "          TOLAYER5: data received by application at %c: %.*s\n",
+                 entity_side(l->entity) == A ? 'A' : 'B', length, data);
+  if (length == 0) {            /* the end of the stream */
+    l->received = 1;
+    return;
+  }
+  l->sim->stats.messages_delivered++;
+  l->sim->delivered[0]++;
+  l->msgsin++;
+  l->bytesin += length;
+  if (l->dst != NULL && fwrite(data, 1, length, l->dst) != (size_t)length) {
+    fprintf(stderr, "udp: cannot write the received data\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/* read the next messages of the stream into l->msgs */
+static void readmsgs(struct udplink *l)
+{
+  const int payload = l->sim->params.payload;
+  struct msg *m;
+  size_t n;
+
+  l->nmsgs = l->first = 0;
+  while (l->nmsgs < l->batch) {
+    m = msg_at(l->msgs, l->msgstride, l->nmsgs);
+    n = fread(m->data, 1, payload, l->src);
+    if (n > 0) {
+      m->length = n;
+      l->nmsgs++;
+    }
+    if ((int)n < payload)
+      break;
+  }
+  if (ferror(l->src)) {
+    fprintf(stderr, "udp: cannot read the data to send\n");
+    exit(EXIT_FAILURE);
+  }
+  if (feof(l->src)) {
+    msg_at(l->msgs, l->msgstride, l->nmsgs++)->length = 0;
+    l->eof = 1;
+  }
+}
+
+void udp_drain(struct udplink *l)
+{
+  int i, accepted;
+
+  if (l->src == NULL || l->ended || l->producing)
+    return;
+  l->producing = 1;             /* output() may drain the backlog itself */
+  for (;;) {
+    if (l->first == l->nmsgs)
+      readmsgs(l);
+    accepted = l->sim->params.protocol->output(l->sim, l->entity,
+                                               msg_at(l->msgs, l->msgstride, l->first),
+                                               l->nmsgs - l->first);
+    for (i = l->first; i < l->first + accepted; i++)
+      l->bytesout += msg_at(l->msgs, l->msgstride, i)->length;
+    l->sim->nsim += accepted;
+    l->first += accepted;
+    if (l->first < l->nmsgs)    /* the window is full */
+      break;
+    if (l->eof) {
+      l->ended = 1;
+      l->msgsout = l->sim->nsim - 1;
+      break;
+    }
+  }
+  if (!l->ended)
+    l->msgsout = l->sim->nsim;
+  l->producing = 0;
+}
+
+/* everything sent was acknowledged and the incoming stream delivered */
+static int complete(const struct udplink *l)
+{
+  return (l->src == NULL || (l->ended && l->deadline < 0)) &&
+         (l->dst == NULL || l->received);
+}
+
+/* run the event loop until the transfer is over.  returns -1 (after */
+/* printing why) if the peer goes silent first */
+static int run(struct udplink *l, double linger, double giveup)
+{
+  struct epoll_event ev[2];
+  double now;
+  int i, n, rounds;
+
+  udp_drain(l);
+  for (;;) {
+    flush(l);
+    if (l->deadline >= 0 && (l->armed < 0 || l->deadline < l->armed))
+      arm(l, l->deadline);
+    now = monotonic();
+    if (l->finished == 0 && complete(l))
+      l->finished = now;
+    if (l->finished > 0 && (l->dst == NULL || now - l->heard >= linger))
+      return 0;
+    if (giveup > 0 && now - l->heard >= giveup) {
+      fprintf(stderr, "udp: nothing heard from the peer for %g seconds\n", giveup);
+      return -1;
+    }
+
+    n = epoll_wait(l->ep, ev, 2, UDP_TICK);
+    if (n < 0 && errno != EINTR) {
+      perror("udp: epoll_wait");
+      return -1;
+    }
+    settime(l);
+    for (i = 0; i < n; i++) {
+      if (ev[i].data.fd == l->tfd)
+        timerexpired(l);
+      else
+        for (rounds = 0; rounds < UDP_ROUNDS && receive(l) == l->batch; rounds++)
+          flush(l);             /* answers go out while more arrive */
+    }
+  }
+}
+
+/* look up "[host]:port"; a missing host means any local address */
+static struct addrinfo *lookup(const char *spec, int family, int passive)
+{
+  struct addrinfo hints, *res;
+  char host[PARAM_STRLEN];
+  const char *colon = strrchr(spec, ':');
+  int err;
+
+  if (colon == NULL || colon - spec >= (int)sizeof(host)) {
+    fprintf(stderr, "udp: %s is not host:port\n", spec);
+    return NULL;
+  }
+  memcpy(host, spec, colon - spec);
+  host[colon - spec] = '\0';
+  if (host[0] == '[' && colon - spec >= 2 && host[colon - spec - 1] == ']') {
+    memmove(host, host + 1, colon - spec - 2);   /* [v6 address] */
+    host[colon - spec - 2] = '\0';
+  }
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = family;
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_flags = passive ? AI_PASSIVE : 0;
+  if ((err = getaddrinfo(host[0] ? host : NULL, colon + 1, &hints, &res)) != 0) {
+    fprintf(stderr, "udp: %s: %s\n", spec, gai_strerror(err));
+    return NULL;
+  }
+  return res;
+}
+
+/* the socket bound to local and connected to peer, -1 (after printing why) */
+static int opensocket(const char *local, const char *peer, int sockbuf)
+{
+  struct addrinfo *to, *at;
+  int fd;
+
+  if ((to = lookup(peer, AF_UNSPEC, 0)) == NULL)
+    return -1;
+  if ((at = lookup(local, to->ai_family, 1)) == NULL) {
+    freeaddrinfo(to);
+    return -1;
+  }
+  fd = socket(to->ai_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd >= 0) {
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sockbuf, sizeof(sockbuf));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &sockbuf, sizeof(sockbuf));
+    if (bind(fd, at->ai_addr, at->ai_addrlen) < 0) {
+      fprintf(stderr, "udp: cannot bind to %s: %s\n", local, strerror(errno));
+      close(fd);
+      fd = -1;
+    }
+    /* connected, so only the peer's datagrams come in */
+    else if (connect(fd, to->ai_addr, to->ai_addrlen) < 0) {
+      fprintf(stderr, "udp: cannot connect to %s: %s\n", peer, strerror(errno));
+      close(fd);
+      fd = -1;
+    }
+  }
+  else
+    perror("udp: socket");
+  freeaddrinfo(at);
+  freeaddrinfo(to);
+  return fd;
+}
+
+/* a link of batch datagrams each way, without its buffers, socket and files */
+static struct udplink *newlink(int batch)
+{
+  struct udplink *l;
+
+  l = calloc(1, sizeof(struct udplink));
+  if (l == 0) {
+    printf("memory allocation for the link failed.");
+    exit(EXIT_FAILURE);
+  }
+  l->batch = batch;
+  l->deadline = l->armed = -1;
+  l->fd = l->tfd = l->ep = -1;
+  return l;
+}
+
+/* the datagrams and messages of l, as large as the packets and */
+/* messages of its simulation need */
+static void newbuffers(struct udplink *l)
+{
+  const int batch = l->batch;
+  char *arrays;
+  int i;
+
+  l->room = pkt_room(&l->sim->params);
+  l->slot = (UDP_HDRLEN + l->room + 7) / 8 * 8;
+  l->msgstride = l->sim->msgstride;
+
+  /* the message headers, iovecs, messages and buffers, one block */
+  arrays = malloc(2 * batch * (sizeof(struct mmsghdr) + sizeof(struct iovec) + l->slot) +
+                  (batch + 1) * l->msgstride);
+  if (arrays == 0) {
+    printf("memory allocation for datagrams failed.");
+    exit(EXIT_FAILURE);
+  }
+  l->outmsg = (struct mmsghdr *)arrays;
+  arrays += batch * sizeof(struct mmsghdr);
+  l->inmsg = (struct mmsghdr *)arrays;
+  arrays += batch * sizeof(struct mmsghdr);
+  l->outiov = (struct iovec *)arrays;
+  arrays += batch * sizeof(struct iovec);
+  l->iniov = (struct iovec *)arrays;
+  arrays += batch * sizeof(struct iovec);
+  l->outbuf = arrays;
+  arrays += batch * l->slot;
+  l->inbuf = arrays;
+  arrays += batch * l->slot;
+  l->msgs = (struct msg *)arrays;   /* one more, for the empty message */
+
+  memset(l->outmsg, 0, 2 * batch * sizeof(struct mmsghdr));
+  for (i = 0; i < batch; i++) {
+    l->outiov[i].iov_base = l->outbuf + i * l->slot;
+    l->outmsg[i].msg_hdr.msg_iov = &l->outiov[i];
+    l->outmsg[i].msg_hdr.msg_iovlen = 1;
+    l->iniov[i].iov_base = l->inbuf + i * l->slot;
+    l->iniov[i].iov_len = l->slot;
+    l->inmsg[i].msg_hdr.msg_iov = &l->iniov[i];
+    l->inmsg[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+static void freelink(struct udplink *l)
+{
+  if (l->ep >= 0)
+    close(l->ep);
+  if (l->tfd >= 0)
+    close(l->tfd);
+  if (l->fd >= 0)
+    close(l->fd);
+  if (l->src != NULL && l->src != stdin)
+    fclose(l->src);
+  if (l->dst != NULL && l->dst != stdout)
+    fclose(l->dst);
+  free(l->outmsg);              /* the block of every array, if any */
+  free(l);
+}
+
+/* open file for reading or writing, "-" for stdin or stdout */
+static FILE *openstream(const char *file, int writing)
+{
+  FILE *fp;
+
+  if (strcmp(file, "-") == 0)
+    fp = writing ? stdout : stdin;
+  else if ((fp = fopen(file, writing ? "wb" : "rb")) == NULL) {
+    fprintf(stderr, "udp: cannot open %s\n", file);
+    return NULL;
+  }
+  setvbuf(fp, NULL, _IOFBF, 1 << 20);
+  return fp;
+}
+
+static void report(const struct udplink *l, FILE *fp)
+{
+  const struct sim_stats *s = &l->sim->stats;
+  double end = l->finished > 0 ? l->finished : monotonic();
+  double secs = end - (l->began > 0 ? l->began : l->start);
+
+  fprintf(fp, "udp: side %c, %s in %f seconds\n", entity_side(l->entity) == A ? 'A' : 'B',
+          l->finished > 0 ? "transfer complete" : "transfer incomplete", secs);
+  if (l->src != NULL)
+    fprintf(fp, "sent %lld bytes in %ld messages:  %f Mbit/s \n", l->bytesout, l->msgsout,
+            secs > 0 ? l->bytesout * 8e-6 / secs : 0.0);
+  if (l->dst != NULL || l->msgsin > 0)
+    fprintf(fp, "received %lld bytes in %ld messages:  %f Mbit/s \n", l->bytesin, l->msgsin,
+            secs > 0 ? l->bytesin * 8e-6 / secs : 0.0);
+  fprintf(fp, "datagrams sent:  %ld in %ld batches, %ld failed \n", l->dgsent, l->sendcalls,
+          l->senderrors);
+  fprintf(fp, "datagrams received:  %ld in %ld batches, %ld malformed \n", l->dgrecv,
+          l->recvcalls, l->malformed);
+  fprintf(fp, "number of packet resends:  %d \n", s->packets_resent);
+  if (l->sim->params.congestion != CC_NONE)
+    fprintf(fp, "number of fast retransmits:  %d \n", s->fast_retransmits);
+  fprintf(fp, "number of valid (not corrupt or duplicate) acknowledgements received:  %d \n",
+          s->new_ACKs);
+  fprintf(fp, "number of correct packets received:  %d \n", s->packets_received);
+}
+
+static void udpusage(void)
+{
+  printf("usage: udp --bind [HOST]:PORT --peer HOST:PORT [--send FILE] [--receive FILE]\n");
+  printf("           [--side a|b] [--time-unit S] [--batch N] [--sockbuf BYTES]\n");
+  printf("           [--linger S] [--give-up S] [parameter flags...]\n");
+}
+
+int udp_main(int argc, char **argv)
+{
+  struct sim_params params;
+  struct simulation *sim;
+  struct udplink *l;
+  struct epoll_event ev;
+  char **rest;
+  const char *local = NULL, *peer = NULL, *send = NULL, *recv = NULL, *side = NULL;
+  double unit = 0.001, linger = 1.0, giveup = 30.0;
+  int i, nrest = 1, batch = 64, sockbuf = 4 << 20, status;
+
+  params_default(&params);
+
+  /* pick out the udp options, pass the rest on as parameter flags */
+  rest = malloc((argc + 1) * sizeof(char *));
+  rest[0] = argv[0];
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+      udpusage();
+      free(rest);
+      return EXIT_SUCCESS;
+    }
+    if (i + 1 < argc && strcmp(argv[i], "--bind") == 0)
+      local = argv[++i];
+    else if (i + 1 < argc && strcmp(argv[i], "--peer") == 0)
+      peer = argv[++i];
+    else if (i + 1 < argc && strcmp(argv[i], "--send") == 0)
+      send = argv[++i];
+    else if (i + 1 < argc && strcmp(argv[i], "--receive") == 0)
+      recv = argv[++i];
+    else if (i + 1 < argc && strcmp(argv[i], "--side") == 0)
+      side = argv[++i];
+    else if (i + 1 < argc && strcmp(argv[i], "--time-unit") == 0)
+      unit = atof(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "--batch") == 0)
+      batch = atoi(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "--sockbuf") == 0)
+      sockbuf = atoi(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "--linger") == 0)
+      linger = atof(argv[++i]);
+    else if (i + 1 < argc && strcmp(argv[i], "--give-up") == 0)
+      giveup = atof(argv[++i]);
+    else
+      rest[nrest++] = argv[i];
+  }
+  rest[nrest] = NULL;
+  i = params_parse_args(&params, nrest, rest);
+  free(rest);
+  if (i < 0)
+    return EXIT_FAILURE;
+
+  if (local == NULL || peer == NULL || (send == NULL && recv == NULL)) {
+    fprintf(stderr, "udp: need --bind, --peer and --send or --receive\n");
+    udpusage();
+    return EXIT_FAILURE;
+  }
+  if (side == NULL)
+    side = send != NULL ? "a" : "b";
+  if ((strcmp(side, "a") != 0 && strcmp(side, "b") != 0) ||
+      (!params.bidirectional && (strcmp(side, "a") == 0 ? recv : send) != NULL)) {
+    fprintf(stderr, "udp: --side is a or b, and only A sends unless --bidirectional 1\n");
+    return EXIT_FAILURE;
+  }
+  if (unit <= 0.0 || batch < 1 || batch > UDP_MAXBATCH || sockbuf < 0 || linger < 0.0) {
+    fprintf(stderr, "udp: need --time-unit > 0, --batch 1..%d, --sockbuf >= 0 and --linger >= 0\n",
+            UDP_MAXBATCH);
+    return EXIT_FAILURE;
+  }
+  if (params.flows != 1 || params.partitions != 1 || params.evlogfile[0] != '\0' ||
+      params.checkpoint[0] != '\0' || params.restore[0] != '\0') {
+    fprintf(stderr, "udp: one flow only, without event logs or checkpoints\n");
+    return EXIT_FAILURE;
+  }
+
+  l = newlink(batch);
+  l->entity = strcmp(side, "a") == 0 ? A : B;
+  l->unit = unit;
+  if ((sim = sim_attach(&params, l)) == NULL) {
+    freelink(l);
+    return EXIT_FAILURE;
+  }
+  l->sim = sim;
+  newbuffers(l);
+  if ((send != NULL && (l->src = openstream(send, 0)) == NULL) ||
+      (recv != NULL && (l->dst = openstream(recv, 1)) == NULL) ||
+      (l->fd = opensocket(local, peer, sockbuf)) < 0) {
+    sim_destroy(sim);
+    freelink(l);
+    return EXIT_FAILURE;
+  }
+  l->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+  l->ep = epoll_create1(EPOLL_CLOEXEC);
+  if (l->tfd < 0 || l->ep < 0) {
+    perror("udp: timerfd or epoll");
+    sim_destroy(sim);
+    freelink(l);
+    return EXIT_FAILURE;
+  }
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = l->fd;
+  epoll_ctl(l->ep, EPOLL_CTL_ADD, l->fd, &ev);
+  ev.data.fd = l->tfd;
+  epoll_ctl(l->ep, EPOLL_CTL_ADD, l->tfd, &ev);
+
+  l->start = l->heard = monotonic();
+  status = run(l, linger, giveup) < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+  if (l->dst != NULL && fflush(l->dst) != 0) {
+    fprintf(stderr, "udp: cannot write the received data\n");
+    status = EXIT_FAILURE;
+  }
+  /* the data may be on stdout */
+  report(l, l->dst == stdout ? stderr : stdout);
+  sim_destroy(sim);
+  freelink(l);
+  return status;
+}
+
+#else
+
+int udp_main(int argc, char **argv)
+{
+  (void)argc;
+  (void)argv;
+  fprintf(stderr, "udp: needs Linux (recvmmsg, sendmmsg, timerfd and epoll)\n");
+  return EXIT_FAILURE;
+}
+
+/* never attached elsewhere */
+void udp_tolayer3(struct udplink *l, const struct pkt *packet)
+{
+  (void)l;
+  (void)packet;
+}
+
+void udp_tolayer5(struct udplink *l, const char *data, int length)
+{
+  (void)l;
+  (void)data;
+  (void)length;
+}
+
+void udp_starttimer(struct udplink *l, double increment)
+{
+  (void)l;
+  (void)increment;
+}
+
+void udp_stoptimer(struct udplink *l)
+{
+  (void)l;
+}
+
+void udp_drain(struct udplink *l)
+{
+  (void)l;
+}
+
+#endif
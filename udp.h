@@ -0,0 +1,60 @@
+#ifndef UDP_H
+#define UDP_H
+
+#include "emulator.h"
+
+/* ******************************************************************
+   The protocols over a real network.
+
+   Instead of the simulated channel, one side of a flow runs in this
+   process and the other on a peer host, and their packets travel as
+   UDP datagrams.  The protocol code is the same: tolayer3(),
+   tolayer5(), starttimer(), stoptimer() and drainbacklog() hand over
+   to the routines below when the simulation is attached to a link
+   (see sim_attach() in emulator.h), and time is the wall clock, in
+   units of --time-unit seconds, so timeouts and ACK delays keep the
+   meaning they have in a simulation.
+
+   usage: prog udp --bind [HOST]:PORT --peer HOST:PORT
+                   [--send FILE] [--receive FILE] [--side a|b]
+                   [--time-unit S] [--batch N] [--sockbuf BYTES]
+                   [--linger S] [--give-up S] [parameter flags...]
+
+   The side with --send streams FILE ("-" for stdin) as messages of
+   --payload bytes, and a message of no bytes ends the stream; the
+   side with --receive writes what is delivered to FILE ("-" for
+   stdout).  The sender reads the next messages whenever the protocol
+   drains its backlog, so its window stays full and nothing is dropped.
+   It is side A unless --side says otherwise; with --bidirectional 1
+   both hosts may send and receive, one as A and one as B.
+
+   Datagrams are a 20-byte header (seqnum, acknum, checksum, length
+   and flags, 32 bits each in network byte order) followed by the
+   payload bytes in use.  Outgoing ones are queued and sent --batch at
+   a time with sendmmsg(), at the latest before the process waits, and
+   incoming ones are read the same way with recvmmsg().  The timer is
+   a timerfd watched by epoll with the socket; it is only rearmed when
+   it is due before the time it is set for, so stopping and restarting
+   it on every ACK costs no system call.
+
+   A run ends once everything sent is acknowledged and the end of any
+   incoming stream delivered, and then, if receiving, after --linger
+   seconds without a datagram to answer the peer's last resends.  It
+   fails if the peer is silent for --give-up seconds.  Needs Linux.
+**********************************************************************/
+
+/* bytes of the header in front of the payload of a datagram */
+#define UDP_HDRLEN  20
+
+/* run over UDP from command-line arguments (argv[0] is "udp"). */
+/* returns the process exit status */
+extern int udp_main(int argc, char **argv);
+
+/* the emulator's routines, attached to link l */
+extern void udp_tolayer3(struct udplink *l, const struct pkt *packet);
+extern void udp_tolayer5(struct udplink *l, const char *data, int length);
+extern void udp_starttimer(struct udplink *l, double increment);
+extern void udp_stoptimer(struct udplink *l);
+extern void udp_drain(struct udplink *l);
+
+#endif